@@ -13,6 +13,159 @@
 #include <util/time.h>
 #include <util/translation.h>
 
+#include <algorithm>
+#include <bit>
+
+namespace {
+using Prefix = std::array<uint8_t, ADDR_IPV6_SIZE>;
+
+//! Bit i of a prefix, counting from the most significant bit of the first byte.
+bool GetBit(const Prefix& prefix, size_t i)
+{
+    return (prefix[i / 8] >> (7 - i % 8)) & 1;
+}
+
+//! Number of leading bits, up to max_bits, that two prefixes have in common.
+size_t CommonBits(const Prefix& a, const Prefix& b, size_t max_bits)
+{
+    size_t bits{0};
+    for (size_t i{0}; bits < max_bits; ++i) {
+        const uint8_t diff = a[i] ^ b[i];
+        if (diff != 0) {
+            bits += std::countl_zero(diff);
+            break;
+        }
+        bits += 8;
+    }
+    return std::min(bits, max_bits);
+}
+
+//! Clear all but the first `bits` bits of a prefix.
+Prefix MaskPrefix(Prefix prefix, size_t bits)
+{
+    for (size_t i{0}; i < prefix.size(); ++i) {
+        if (bits >= 8 * (i + 1)) continue;
+        prefix[i] &= bits > 8 * i ? static_cast<uint8_t>(0xff << (8 - (bits - 8 * i))) : 0;
+    }
+    return prefix;
+}
+} // namespace
+
+std::unique_ptr<SubNetTrie::Node>* SubNetTrie::Root(const CNetAddr& addr)
+{
+    if (addr.IsIPv4()) return &m_ipv4;
+    if (addr.IsIPv6()) return &m_ipv6;
+    return nullptr;
+}
+
+const std::unique_ptr<SubNetTrie::Node>* SubNetTrie::Root(const CNetAddr& addr) const
+{
+    return const_cast<SubNetTrie*>(this)->Root(addr);
+}
+
+std::unique_ptr<SubNetTrie::Node> SubNetTrie::MakeNode(const CSubNet& sub_net)
+{
+    const CNetAddr& network{sub_net.network};
+    auto node{std::make_unique<Node>()};
+    std::copy(network.m_addr.begin(), network.m_addr.end(), node->prefix.begin());
+    for (size_t i{0}; i < network.m_addr.size(); ++i) {
+        node->bits += std::popcount(sub_net.netmask[i]);
+    }
+    return node;
+}
+
+void SubNetTrie::Insert(const CSubNet& sub_net, int64_t ban_until)
+{
+    if (!sub_net.IsValid()) return;
+    std::unique_ptr<Node>* slot{Root(sub_net.network)};
+    if (!slot) {
+        m_hosts[sub_net.network] = ban_until;
+        return;
+    }
+    auto node{MakeNode(sub_net)};
+    node->ban_until = ban_until;
+
+    while (*slot) {
+        Node& cur{**slot};
+        const size_t common{CommonBits(cur.prefix, node->prefix, std::min(cur.bits, node->bits))};
+        if (common == cur.bits && common == node->bits) {
+            cur.ban_until = ban_until;
+            return;
+        }
+        if (common == cur.bits) {
+            // The new subnet lies within this one.
+            slot = &cur.children[GetBit(node->prefix, common)];
+            continue;
+        }
+        if (common == node->bits) {
+            // The new subnet contains this one.
+            node->children[GetBit(cur.prefix, common)] = std::move(*slot);
+            break;
+        }
+        // They diverge after `common` bits, so join them below a new node.
+        auto branch{std::make_unique<Node>()};
+        branch->prefix = MaskPrefix(node->prefix, common);
+        branch->bits = common;
+        branch->children[GetBit(node->prefix, common)] = std::move(node);
+        branch->children[GetBit(cur.prefix, common)] = std::move(*slot);
+        node = std::move(branch);
+        break;
+    }
+    *slot = std::move(node);
+}
+
+void SubNetTrie::Erase(const CSubNet& sub_net)
+{
+    if (!sub_net.IsValid()) return;
+    std::unique_ptr<Node>* root{Root(sub_net.network)};
+    if (!root) {
+        m_hosts.erase(sub_net.network);
+        return;
+    }
+    Erase(*root, *MakeNode(sub_net));
+}
+
+void SubNetTrie::Erase(std::unique_ptr<Node>& slot, const Node& key)
+{
+    Node* node{slot.get()};
+    if (!node || node->bits > key.bits || CommonBits(node->prefix, key.prefix, node->bits) < node->bits) return;
+    if (node->bits == key.bits) {
+        node->ban_until.reset();
+    } else {
+        Erase(node->children[GetBit(key.prefix, node->bits)], key);
+    }
+    // Drop nodes that are neither a subnet nor needed to join two others.
+    if (node->ban_until || (node->children[0] && node->children[1])) return;
+    slot = std::move(node->children[0] ? node->children[0] : node->children[1]);
+}
+
+void SubNetTrie::Clear()
+{
+    m_ipv4.reset();
+    m_ipv6.reset();
+    m_hosts.clear();
+}
+
+bool SubNetTrie::Match(const CNetAddr& addr, int64_t now) const
+{
+    if (!addr.IsValid()) return false;
+    const std::unique_ptr<Node>* root{Root(addr)};
+    if (!root) {
+        const auto it{m_hosts.find(addr)};
+        return it != m_hosts.end() && now < it->second;
+    }
+    Prefix key{};
+    std::copy(addr.m_addr.begin(), addr.m_addr.end(), key.begin());
+    const size_t key_bits{addr.m_addr.size() * 8};
+    // Every subnet containing addr lies on the path towards it.
+    for (const Node* node{root->get()}; node;) {
+        if (CommonBits(node->prefix, key, node->bits) < node->bits) return false;
+        if (node->ban_until && now < *node->ban_until) return true;
+        if (node->bits >= key_bits) return false;
+        node = node->children[GetBit(key, node->bits)].get();
+    }
+    return false;
+}
 
 BanMan::BanMan(fs::path ban_file, CClientUIInterface* client_interface, int64_t default_ban_time)
     : m_client_interface(client_interface), m_ban_db(std::move(ban_file)), m_default_ban_time(default_ban_time)
@@ -34,6 +187,10 @@ void BanMan::LoadBanlist()
 
     const auto start{SteadyClock::now()};
     if (m_ban_db.Read(m_banned)) {
+        m_banned_trie.Clear();
+        for (const auto& [sub_net, ban_entry] : m_banned) {
+            m_banned_trie.Insert(sub_net, ban_entry.nBanUntil);
+        }
         SweepBanned(); // sweep out unused entries
 
         LogDebug(BCLog::NET, "Loaded %d banned node addresses/subnets  %dms\n", m_banned.size(),
@@ -41,6 +198,7 @@ void BanMan::LoadBanlist()
     } else {
         LogPrintf("Recreating the banlist database\n");
         m_banned = {};
+        m_banned_trie.Clear();
         m_is_dirty = true;
     }
 }
@@ -74,6 +232,7 @@ void BanMan::ClearBanned()
     {
         LOCK(m_banned_mutex);
         m_banned.clear();
+        m_banned_trie.Clear();
         m_is_dirty = true;
     }
     DumpBanlist(); //store banlist to disk
@@ -90,15 +249,7 @@ bool BanMan::IsBanned(const CNetAddr& net_addr)
 {
     auto current_time = GetTime();
     LOCK(m_banned_mutex);
-    for (const auto& it : m_banned) {
-        CSubNet sub_net = it.first;
-        CBanEntry ban_entry = it.second;
-
-        if (current_time < ban_entry.nBanUntil && sub_net.Match(net_addr)) {
-            return true;
-        }
-    }
-    return false;
+    return m_banned_trie.Match(net_addr, current_time);
 }
 
 bool BanMan::IsBanned(const CSubNet& sub_net)
@@ -143,6 +294,7 @@ void BanMan::Ban(const CSubNet& sub_net, int64_t ban_time_offset, bool since_uni
         LOCK(m_banned_mutex);
         if (m_banned[sub_net].nBanUntil < ban_entry.nBanUntil) {
             m_banned[sub_net] = ban_entry;
+            m_banned_trie.Insert(sub_net, ban_entry.nBanUntil);
             m_is_dirty = true;
         } else
             return;
@@ -164,6 +316,7 @@ bool BanMan::Unban(const CSubNet& sub_net)
     {
         LOCK(m_banned_mutex);
         if (m_banned.erase(sub_net) == 0) return false;
+        m_banned_trie.Erase(sub_net);
         m_is_dirty = true;
     }
     if (m_client_interface) m_client_interface->BannedListChanged();
@@ -191,6 +344,7 @@ void BanMan::SweepBanned()
         CBanEntry ban_entry = (*it).second;
         if (!sub_net.IsValid() || now > ban_entry.nBanUntil) {
             m_banned.erase(it++);
+            m_banned_trie.Erase(sub_net);
             m_is_dirty = true;
             notify_ui = true;
             LogDebug(BCLog::NET, "Removed banned node address/subnet: %s\n", sub_net.ToString());
@@ -8,12 +8,16 @@
 #include <addrdb.h>
 #include <common/bloom.h>
 #include <net_types.h> // For banmap_t
+#include <netaddress.h>
 #include <sync.h>
 #include <util/fs.h>
 
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <optional>
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static constexpr unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24; // Default 24-hour ban
@@ -22,8 +26,47 @@ static constexpr unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24; // Def
 static constexpr std::chrono::minutes DUMP_BANS_INTERVAL{15};
 
 class CClientUIInterface;
-class CNetAddr;
-class CSubNet;
+
+/**
+ * Index of banned subnets for matching addresses without scanning the whole banlist.
+ *
+ * IPv4 and IPv6 subnets are kept in one path-compressed binary trie per network,
+ * keyed by the subnet's prefix bits, so a lookup visits at most one node per
+ * distinct prefix length along the address. Other networks (Tor, I2P, CJDNS) only
+ * have single-host subnets, which are kept in a map.
+ */
+class SubNetTrie
+{
+public:
+    //! Add a subnet, or update the ban time of one that is already present.
+    void Insert(const CSubNet& sub_net, int64_t ban_until);
+    void Erase(const CSubNet& sub_net);
+    void Clear();
+
+    //! Return whether addr is in any subnet banned until after `now`.
+    bool Match(const CNetAddr& addr, int64_t now) const;
+
+private:
+    struct Node {
+        //! The first `bits` bits of a subnet or branching point; the remaining bits are zero.
+        std::array<uint8_t, ADDR_IPV6_SIZE> prefix{};
+        uint8_t bits{0};
+        //! Set if `prefix` is a banned subnet.
+        std::optional<int64_t> ban_until;
+        std::unique_ptr<Node> children[2];
+    };
+
+    std::unique_ptr<Node> m_ipv4;
+    std::unique_ptr<Node> m_ipv6;
+    std::map<CNetAddr, int64_t> m_hosts;
+
+    //! The trie for an address's network, or nullptr if it has none.
+    std::unique_ptr<Node>* Root(const CNetAddr& addr);
+    const std::unique_ptr<Node>* Root(const CNetAddr& addr) const;
+    //! A leaf node holding the prefix of an IPv4 or IPv6 subnet.
+    static std::unique_ptr<Node> MakeNode(const CSubNet& sub_net);
+    static void Erase(std::unique_ptr<Node>& slot, const Node& key);
+};
 
 // Banman manages two related but distinct concepts:
 //
@@ -86,6 +129,8 @@ private:
 
     Mutex m_banned_mutex;
     banmap_t m_banned GUARDED_BY(m_banned_mutex);
+    //! Same subnets as m_banned, for IsBanned(const CNetAddr&).
+    SubNetTrie m_banned_trie GUARDED_BY(m_banned_mutex);
     bool m_is_dirty GUARDED_BY(m_banned_mutex){false};
     CClientUIInterface* m_client_interface = nullptr;
     CBanDB m_ban_db;
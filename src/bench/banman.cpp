@@ -0,0 +1,78 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <banman.h>
+#include <bench/bench.h>
+#include <net_types.h>
+#include <netaddress.h>
+#include <random.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+static constexpr size_t NUM_BANNED_SUBNETS{100'000};
+
+static CNetAddr RandomAddr(FastRandomContext& rng, bool ipv4)
+{
+    CNetAddr addr;
+    if (ipv4) {
+        const auto bytes{rng.randbytes<uint8_t>(ADDR_IPV4_SIZE)};
+        addr.SetLegacyIPv6(std::vector<uint8_t>{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, bytes[0], bytes[1], bytes[2], bytes[3]});
+    } else {
+        auto bytes{rng.randbytes<uint8_t>(ADDR_IPV6_SIZE)};
+        bytes[0] = 0x20;
+        addr.SetLegacyIPv6(bytes);
+    }
+    return addr;
+}
+
+//! A banlist like one loaded from a threat feed: mostly single hosts, some ranges.
+static banmap_t MakeBanList(FastRandomContext& rng)
+{
+    banmap_t banned;
+    while (banned.size() < NUM_BANNED_SUBNETS) {
+        const bool ipv4{rng.randrange(4) != 0};
+        const bool host{rng.randrange(4) != 0};
+        const uint8_t bits{static_cast<uint8_t>(host ? (ipv4 ? 32 : 128) : (ipv4 ? 16 + rng.randrange(16) : 32 + rng.randrange(64)))};
+        CBanEntry ban_entry{/*nCreateTimeIn=*/0};
+        ban_entry.nBanUntil = std::numeric_limits<int64_t>::max();
+        banned.emplace(CSubNet{RandomAddr(rng, ipv4), bits}, ban_entry);
+    }
+    return banned;
+}
+
+static void BanManMatchTrie(benchmark::Bench& bench)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    SubNetTrie trie;
+    for (const auto& [sub_net, ban_entry] : MakeBanList(rng)) {
+        trie.Insert(sub_net, ban_entry.nBanUntil);
+    }
+    bench.run([&] {
+        const bool banned{trie.Match(RandomAddr(rng, rng.randbool()), /*now=*/0)};
+        ankerl::nanobench::doNotOptimizeAway(banned);
+    });
+}
+
+//! The full scan of the banlist that SubNetTrie replaces, for comparison.
+static void BanManMatchLinear(benchmark::Bench& bench)
+{
+    FastRandomContext rng{/*fDeterministic=*/true};
+    const banmap_t banned{MakeBanList(rng)};
+    bench.run([&] {
+        const CNetAddr addr{RandomAddr(rng, rng.randbool())};
+        bool match{false};
+        for (const auto& [sub_net, ban_entry] : banned) {
+            if (0 < ban_entry.nBanUntil && sub_net.Match(addr)) {
+                match = true;
+                break;
+            }
+        }
+        ankerl::nanobench::doNotOptimizeAway(match);
+    });
+}
+
+BENCHMARK(BanManMatchTrie, benchmark::PriorityLevel::HIGH);
+BENCHMARK(BanManMatchLinear, benchmark::PriorityLevel::HIGH);
@@ -9,9 +9,11 @@
 #include <random.h>
 #include <script/script.h>
 #include <sync.h>
+#include <txmempool.h>
 #include <test/util/mining.h>
 #include <test/util/script.h>
 #include <test/util/setup_common.h>
+#include <test/util/txmempool.h>
 #include <validation.h>
 
 #include <array>
@@ -51,18 +53,68 @@ static void AssembleBlock(benchmark::Bench& bench)
         PrepareBlock(test_setup->m_node, P2WSH_OP_TRUE);
     });
 }
-static void BlockAssemblerAddPackageTxns(benchmark::Bench& bench)
+//! Fill the mempool with small clusters: a parent paying little, spent by a few children paying more.
+static void PopulateMempoolWithClusters(node::NodeContext& node, FastRandomContext& det_rand, size_t num_clusters)
+{
+    LOCK2(cs_main, node.mempool->cs);
+    TestMemPoolEntryHelper entry;
+    for (size_t c{0}; c < num_clusters; ++c) {
+        CMutableTransaction parent;
+        parent.vin.emplace_back(COutPoint{Txid::FromUint256(det_rand.rand256()), 0});
+        const uint32_t num_children{static_cast<uint32_t>(det_rand.randrange(5))};
+        parent.vout.resize(num_children + 1, CTxOut{10000, P2WSH_OP_TRUE});
+        const Txid parent_txid{parent.GetHash()};
+        node.mempool->addUnchecked(entry.Fee(100 * det_rand.randrange(30)).FromTx(parent));
+        for (uint32_t n{0}; n < num_children; ++n) {
+            CMutableTransaction child;
+            child.vin.emplace_back(COutPoint{parent_txid, n});
+            child.vout.emplace_back(5000, P2WSH_OP_TRUE);
+            node.mempool->addUnchecked(entry.Fee(100 * det_rand.randrange(100)).FromTx(child));
+        }
+    }
+}
+
+static void BlockAssemblerAddTxns(benchmark::Bench& bench, bool cluster_linearization, bool small_clusters)
 {
     FastRandomContext det_rand{true};
     auto testing_setup{MakeNoLogFileContext<TestChain100Setup>()};
-    testing_setup->PopulateMempool(det_rand, /*num_transactions=*/1000, /*submit=*/true);
+    if (small_clusters) {
+        // More than fits in a block
+        PopulateMempoolWithClusters(testing_setup->m_node, det_rand, /*num_clusters=*/5000);
+    } else {
+        testing_setup->PopulateMempool(det_rand, /*num_transactions=*/1000, /*submit=*/true);
+    }
     node::BlockAssembler::Options assembler_options;
     assembler_options.test_block_validity = false;
+    assembler_options.cluster_linearization = cluster_linearization;
 
     bench.run([&] {
         PrepareBlock(testing_setup->m_node, P2WSH_OP_TRUE, assembler_options);
     });
 }
 
+static void BlockAssemblerAddPackageTxns(benchmark::Bench& bench)
+{
+    BlockAssemblerAddTxns(bench, /*cluster_linearization=*/false, /*small_clusters=*/false);
+}
+
+static void BlockAssemblerAddClusterTxns(benchmark::Bench& bench)
+{
+    BlockAssemblerAddTxns(bench, /*cluster_linearization=*/true, /*small_clusters=*/false);
+}
+
+static void BlockAssemblerAddPackageTxnsSmallClusters(benchmark::Bench& bench)
+{
+    BlockAssemblerAddTxns(bench, /*cluster_linearization=*/false, /*small_clusters=*/true);
+}
+
+static void BlockAssemblerAddClusterTxnsSmallClusters(benchmark::Bench& bench)
+{
+    BlockAssemblerAddTxns(bench, /*cluster_linearization=*/true, /*small_clusters=*/true);
+}
+
 BENCHMARK(AssembleBlock, benchmark::PriorityLevel::HIGH);
 BENCHMARK(BlockAssemblerAddPackageTxns, benchmark::PriorityLevel::LOW);
+BENCHMARK(BlockAssemblerAddClusterTxns, benchmark::PriorityLevel::LOW);
+BENCHMARK(BlockAssemblerAddPackageTxnsSmallClusters, benchmark::PriorityLevel::LOW);
+BENCHMARK(BlockAssemblerAddClusterTxnsSmallClusters, benchmark::PriorityLevel::LOW);
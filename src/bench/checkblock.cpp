@@ -8,6 +8,7 @@
 #include <common/args.h>
 #include <consensus/validation.h>
 #include <primitives/block.h>
+#include <primitives/block_view.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
 #include <span.h>
@@ -60,5 +61,51 @@ static void DeserializeAndCheckBlockTest(benchmark::Bench& bench)
     });
 }
 
+/** The benchmark block, as read from disk */
+static std::vector<uint8_t> RawBlock()
+{
+    const auto& block{benchmark::data::block413567};
+    return {UCharCast(block.data()), UCharCast(block.data()) + block.size()};
+}
+
+static void ParseBlockViewTest(benchmark::Bench& bench)
+{
+    const std::vector<uint8_t> data{RawBlock()};
+
+    bench.unit("block").run([&] {
+        BlockView view{std::vector<uint8_t>{data}};
+        ankerl::nanobench::doNotOptimizeAway(view.Transactions().size());
+    });
+}
+
+static void StripWitnessTest(benchmark::Bench& bench)
+{
+    const std::vector<uint8_t> data{RawBlock()};
+    std::vector<uint8_t> out;
+
+    bench.unit("block").run([&] {
+        DataStream stream{data};
+        CBlock block;
+        stream >> TX_WITH_WITNESS(block);
+        out.clear();
+        VectorWriter{out, 0, TX_NO_WITNESS(block)};
+    });
+}
+
+static void StripWitnessBlockViewTest(benchmark::Bench& bench)
+{
+    const std::vector<uint8_t> data{RawBlock()};
+    std::vector<uint8_t> out;
+
+    bench.unit("block").run([&] {
+        const BlockView view{std::vector<uint8_t>{data}};
+        out.clear();
+        VectorWriter{out, 0, TX_NO_WITNESS(view)};
+    });
+}
+
 BENCHMARK(DeserializeBlockTest, benchmark::PriorityLevel::HIGH);
 BENCHMARK(DeserializeAndCheckBlockTest, benchmark::PriorityLevel::HIGH);
+BENCHMARK(ParseBlockViewTest, benchmark::PriorityLevel::HIGH);
+BENCHMARK(StripWitnessTest, benchmark::PriorityLevel::HIGH);
+BENCHMARK(StripWitnessBlockViewTest, benchmark::PriorityLevel::HIGH);
@@ -7,14 +7,18 @@
 #include <kernel/cs_main.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
+#include <random.h>
 #include <script/script.h>
 #include <sync.h>
 #include <test/util/setup_common.h>
+#include <test/util/txmempool.h>
 #include <txmempool.h>
 #include <util/check.h>
+#include <util/translation.h>
 
 #include <cstdint>
 #include <memory>
+#include <utility>
 #include <vector>
 
 
@@ -143,4 +147,55 @@ static void MempoolEviction(benchmark::Bench& bench)
     });
 }
 
+/** Add a parent with four children, paying random fees. */
+static void AddCluster(FastRandomContext& rng, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    CMutableTransaction parent;
+    parent.vin.emplace_back(COutPoint{Txid::FromUint256(rng.rand256()), 0});
+    for (int n{0}; n < 4; ++n) parent.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    const CTransactionRef parent_r{MakeTransactionRef(parent)};
+    AddTx(parent_r, 100 * rng.randrange(100), pool);
+    for (uint32_t n{0}; n < parent.vout.size(); ++n) {
+        CMutableTransaction child;
+        child.vin.emplace_back(COutPoint{parent_r->GetHash(), n});
+        child.vout.emplace_back(COIN / 2, CScript() << OP_TRUE);
+        AddTx(MakeTransactionRef(child), 100 * rng.randrange(100), pool);
+    }
+}
+
+// Keep a full mempool at its size limit while clusters keep arriving, as when
+// the mempool is saturated.
+static void MempoolTrim(benchmark::Bench& bench, bool chunk_eviction)
+{
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+    FastRandomContext det_rand{true};
+    auto mempool_opts{MemPoolOptionsForTest(testing_setup->m_node)};
+    mempool_opts.check_ratio = 0;
+    mempool_opts.chunk_eviction = chunk_eviction;
+    bilingual_str error;
+    CTxMemPool pool{mempool_opts, error};
+    LOCK2(cs_main, pool.cs);
+    for (int i{0}; i < 5000; ++i) AddCluster(det_rand, pool);
+    // Trim once, so that the index is complete before measuring.
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    const size_t limit{pool.DynamicMemoryUsage()};
+
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        AddCluster(det_rand, pool);
+        pool.TrimToSize(limit);
+    });
+}
+
+static void MempoolTrimDescendantScore(benchmark::Bench& bench)
+{
+    MempoolTrim(bench, /*chunk_eviction=*/false);
+}
+
+static void MempoolTrimChunks(benchmark::Bench& bench)
+{
+    MempoolTrim(bench, /*chunk_eviction=*/true);
+}
+
 BENCHMARK(MempoolEviction, benchmark::PriorityLevel::HIGH);
+BENCHMARK(MempoolTrimDescendantScore, benchmark::PriorityLevel::LOW);
+BENCHMARK(MempoolTrimChunks, benchmark::PriorityLevel::LOW);
@@ -102,6 +102,12 @@ typedef char* sockopt_arg_type;
 #define USE_POLL
 #endif
 
+// epoll(7) is used by SockWaitSet, which keeps the sockets of the socket handler
+// thread registered with the kernel across waits.
+#if defined(__linux__)
+#define USE_EPOLL
+#endif
+
 // MSG_NOSIGNAL is not available on some platforms, if it doesn't exist define it as 0
 #if !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
@@ -186,6 +186,8 @@ public:
 
     mutable size_t idx_randomized; //!< Index in mempool's txns_randomized
     mutable Epoch::Marker m_epoch_marker; //!< epoch when last touched, useful for graph algorithms
+    mutable uint64_t m_cluster_id{0}; //!< Cluster in the mempool's chunk eviction index, or 0 if not tracked
+    mutable uint32_t m_cluster_pos{0}; //!< Index in that cluster's transactions
 };
 
 using CTxMemPoolEntryRef = CTxMemPoolEntry::CTxMemPoolEntryRef;
@@ -25,6 +25,8 @@ static constexpr unsigned int DEFAULT_MEMPOOL_EXPIRY_HOURS{336};
 static constexpr bool DEFAULT_MEMPOOL_FULL_RBF{true};
 /** Whether to fall back to legacy V1 serialization when writing mempool.dat */
 static constexpr bool DEFAULT_PERSIST_V1_DAT{false};
+/** Default for -mempoolchunkeviction, whether TrimToSize evicts the worst chunks of linearized clusters */
+static constexpr bool DEFAULT_MEMPOOL_CHUNK_EVICTION{false};
 /** Default for -acceptnonstdtxn */
 static constexpr bool DEFAULT_ACCEPT_NON_STD_TXN{false};
 
@@ -57,6 +59,7 @@ struct MemPoolOptions {
     bool require_standard{true};
     bool full_rbf{DEFAULT_MEMPOOL_FULL_RBF};
     bool persist_v1_dat{DEFAULT_PERSIST_V1_DAT};
+    bool chunk_eviction{DEFAULT_MEMPOOL_CHUNK_EVICTION};
     MemPoolLimits limits{};
 
     ValidationSignals* signals{nullptr};
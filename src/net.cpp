@@ -123,8 +123,9 @@ size_t CSerializedNetMsg::GetMemoryUsage() const noexcept
 {
     // Don't count the dynamic memory used for the m_type string, by assuming it fits in the
     // "small string" optimization area (which stores data inside the object itself, up to some
-    // size; 15 bytes in modern libstdc++).
-    return sizeof(*this) + memusage::DynamicUsage(data);
+    // size; 15 bytes in modern libstdc++). A shared payload is counted in full, as it is
+    // kept alive for as long as this message is queued.
+    return sizeof(*this) + memusage::DynamicUsage(data) + (m_shared_data ? memusage::DynamicUsage(*m_shared_data) : 0);
 }
 
 void CConnman::AddAddrFetch(const std::string& strDest)
@@ -648,6 +649,48 @@ void CNode::CopyStats(CNodeStats& stats)
 }
 #undef X
 
+RecvBufferPool g_recv_buffer_pool;
+
+DataStream RecvBufferPool::Get(size_t size)
+{
+    // Pick the smallest class whose buffers fit `size`.
+    const size_t cls{std::bit_width((std::max(size, MIN_BUFFER_SIZE) - 1) / MIN_BUFFER_SIZE)};
+    DataStream buffer;
+    if (cls >= NUM_CLASSES) {
+        buffer.reserve(size);
+        return buffer;
+    }
+    {
+        LOCK(m_mutex);
+        if (!m_idle[cls].empty()) {
+            buffer = std::move(m_idle[cls].back());
+            m_idle[cls].pop_back();
+            m_idle_bytes -= buffer.capacity();
+            return buffer;
+        }
+    }
+    buffer.reserve(MIN_BUFFER_SIZE << cls);
+    return buffer;
+}
+
+void RecvBufferPool::Put(DataStream&& buffer)
+{
+    buffer.clear();
+    const size_t capacity{buffer.capacity()};
+    if (capacity < MIN_BUFFER_SIZE) return;
+    // Buffers go into the largest class they fit, so every buffer of a class is large enough for it.
+    const size_t cls{std::min<size_t>(std::bit_width(capacity / MIN_BUFFER_SIZE) - 1, NUM_CLASSES - 1)};
+    LOCK(m_mutex);
+    if (m_idle_bytes + capacity > MAX_IDLE_BYTES) return;
+    m_idle_bytes += capacity;
+    m_idle[cls].push_back(std::move(buffer));
+}
+
+CNetMessage::~CNetMessage()
+{
+    g_recv_buffer_pool.Put(std::move(m_recv));
+}
+
 bool CNode::ReceiveMsgBytes(Span<const uint8_t> msg_bytes, bool& complete)
 {
     complete = false;
@@ -753,7 +796,14 @@ int V1Transport::readData(Span<const uint8_t> msg_bytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        const size_t new_size{std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024)};
+        if (vRecv.capacity() < new_size) {
+            // Move to a larger buffer from the pool, and give the old one back.
+            DataStream buffer{g_recv_buffer_pool.Get(new_size)};
+            buffer.write(Span{vRecv}.first(nDataPos));
+            g_recv_buffer_pool.Put(std::exchange(vRecv, std::move(buffer)));
+        }
+        vRecv.resize(new_size);
     }
 
     hasher.Write(msg_bytes.first(nCopy));
@@ -816,13 +866,13 @@ bool V1Transport::SetMessageToSend(CSerializedNetMsg& msg) noexcept
     AssertLockNotHeld(m_send_mutex);
     // Determine whether a new message can be set.
     LOCK(m_send_mutex);
-    if (m_sending_header || m_bytes_sent < m_message_to_send.data.size()) return false;
+    if (m_sending_header || m_bytes_sent < m_message_to_send.Payload().size()) return false;
 
     // create dbl-sha256 checksum
-    uint256 hash = Hash(msg.data);
+    uint256 hash = Hash(msg.Payload());
 
     // create header
-    CMessageHeader hdr(m_magic_bytes, msg.m_type.c_str(), msg.data.size());
+    CMessageHeader hdr(m_magic_bytes, msg.m_type.c_str(), msg.Payload().size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     // serialize header
@@ -844,11 +894,11 @@ Transport::BytesToSend V1Transport::GetBytesToSend(bool have_next_message) const
         return {Span{m_header_to_send}.subspan(m_bytes_sent),
                 // We have more to send after the header if the message has payload, or if there
                 // is a next message after that.
-                have_next_message || !m_message_to_send.data.empty(),
+                have_next_message || !m_message_to_send.Payload().empty(),
                 m_message_to_send.m_type
                };
     } else {
-        return {Span{m_message_to_send.data}.subspan(m_bytes_sent),
+        return {m_message_to_send.Payload().subspan(m_bytes_sent),
                 // We only have more to send after this message's payload if there is another
                 // message.
                 have_next_message,
@@ -866,9 +916,10 @@ void V1Transport::MarkBytesSent(size_t bytes_sent) noexcept
         // We're done sending a message's header. Switch to sending its data bytes.
         m_sending_header = false;
         m_bytes_sent = 0;
-    } else if (!m_sending_header && m_bytes_sent == m_message_to_send.data.size()) {
+    } else if (!m_sending_header && m_bytes_sent == m_message_to_send.Payload().size()) {
         // We're done sending a message's data. Wipe the data vector to reduce memory consumption.
         ClearShrink(m_message_to_send.data);
+        m_message_to_send.m_shared_data.reset();
         m_bytes_sent = 0;
     }
 }
@@ -1439,6 +1490,7 @@ CNetMessage V2Transport::GetReceivedMessage(std::chrono::microseconds time, bool
         msg.m_type = std::move(*msg_type);
         msg.m_time = time;
         msg.m_message_size = contents.size();
+        msg.m_recv = g_recv_buffer_pool.Get(contents.size());
         msg.m_recv.resize(contents.size());
         std::copy(contents.begin(), contents.end(), UCharCast(msg.m_recv.data()));
     } else {
@@ -1462,17 +1514,18 @@ bool V2Transport::SetMessageToSend(CSerializedNetMsg& msg) noexcept
     if (!(m_send_state == SendState::READY && m_send_buffer.empty())) return false;
     // Construct contents (encoding message type + payload).
     std::vector<uint8_t> contents;
+    const auto payload{msg.Payload()};
     auto short_message_id = V2_MESSAGE_MAP(msg.m_type);
     if (short_message_id) {
-        contents.resize(1 + msg.data.size());
+        contents.resize(1 + payload.size());
         contents[0] = *short_message_id;
-        std::copy(msg.data.begin(), msg.data.end(), contents.begin() + 1);
+        std::copy(payload.begin(), payload.end(), contents.begin() + 1);
     } else {
         // Initialize with zeroes, and then write the message type string starting at offset 1.
         // This means contents[0] and the unused positions in contents[1..13] remain 0x00.
-        contents.resize(1 + CMessageHeader::COMMAND_SIZE + msg.data.size(), 0);
+        contents.resize(1 + CMessageHeader::COMMAND_SIZE + payload.size(), 0);
         std::copy(msg.m_type.begin(), msg.m_type.end(), contents.data() + 1);
-        std::copy(msg.data.begin(), msg.data.end(), contents.begin() + 1 + CMessageHeader::COMMAND_SIZE);
+        std::copy(payload.begin(), payload.end(), contents.begin() + 1 + CMessageHeader::COMMAND_SIZE);
     }
     // Construct ciphertext in send buffer.
     m_send_buffer.resize(contents.size() + BIP324Cipher::EXPANSION);
@@ -1480,6 +1533,7 @@ bool V2Transport::SetMessageToSend(CSerializedNetMsg& msg) noexcept
     m_send_type = msg.m_type;
     // Release memory
     ClearShrink(msg.data);
+    msg.m_shared_data.reset();
     return true;
 }
 
@@ -1575,6 +1629,9 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode& node) const
     size_t nSentSize = 0;
     bool data_left{false}; //!< second return value (whether unsent data remains)
     std::optional<bool> expected_more;
+    auto& coalesced{node.m_send_coalesced};
+    // Without a socket (already disconnected, or in tests) leave all bytes in the transport.
+    const bool can_coalesce{WITH_LOCK(node.m_sock_mutex, return node.m_sock != nullptr)};
 
     while (true) {
         if (it != node.vSendMsg.end()) {
@@ -1594,9 +1651,19 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode& node) const
         // verify that the previously returned 'more' was correct.
         if (expected_more.has_value()) Assume(!data.empty() == *expected_more);
         expected_more = more;
-        data_left = !data.empty(); // will be overwritten on next loop if all of data gets sent
-        int nBytes = 0;
-        if (!data.empty()) {
+        if (can_coalesce && !data.empty() && more && coalesced.size() + data.size() <= MAX_SEND_COALESCE_SIZE) {
+            // Small pieces (message headers, small messages) that are followed by more data are
+            // collected, so they are sent together with what follows in a single system call.
+            coalesced.insert(coalesced.end(), data.begin(), data.end());
+            node.m_transport->MarkBytesSent(data.size());
+            if (!msg_type.empty()) { // don't report v2 handshake bytes for now
+                node.AccountForSentBytes(msg_type, data.size());
+            }
+            continue;
+        }
+        data_left = !data.empty() || !coalesced.empty(); // will be overwritten on next loop if all of data gets sent
+        ssize_t nBytes = 0;
+        if (data_left) {
             LOCK(node.m_sock_mutex);
             // There is no socket in case we've already disconnected, or in test cases without
             // real connections. In these cases, we bail out immediately and just leave things
@@ -1610,19 +1677,26 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode& node) const
                 flags |= MSG_MORE;
             }
 #endif
-            nBytes = node.m_sock->Send(reinterpret_cast<const char*>(data.data()), data.size(), flags);
+            const Span<const unsigned char> pieces[]{coalesced, data};
+            nBytes = node.m_sock->SendMany(pieces, flags);
         }
         if (nBytes > 0) {
             node.m_last_send = GetTime<std::chrono::seconds>();
             node.nSendBytes += nBytes;
-            // Notify transport that bytes have been processed.
-            node.m_transport->MarkBytesSent(nBytes);
-            // Update statistics per message type.
-            if (!msg_type.empty()) { // don't report v2 handshake bytes for now
-                node.AccountForSentBytes(msg_type, nBytes);
+            // Collected bytes go out first, and were already marked as sent to the transport.
+            const size_t sent_coalesced{std::min<size_t>(nBytes, coalesced.size())};
+            coalesced.erase(coalesced.begin(), coalesced.begin() + sent_coalesced);
+            const size_t sent_data{nBytes - sent_coalesced};
+            if (sent_data > 0) {
+                // Notify transport that bytes have been processed.
+                node.m_transport->MarkBytesSent(sent_data);
+                // Update statistics per message type.
+                if (!msg_type.empty()) { // don't report v2 handshake bytes for now
+                    node.AccountForSentBytes(msg_type, sent_data);
+                }
             }
             nSentSize += nBytes;
-            if ((size_t)nBytes != data.size()) {
+            if (!coalesced.empty() || sent_data != data.size()) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -1639,7 +1713,7 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode& node) const
         }
     }
 
-    node.fPauseSend = node.m_send_memusage + node.m_transport->GetSendMemoryUsage() > nSendBufferMaxSize;
+    node.fPauseSend = node.m_send_memusage + coalesced.size() + node.m_transport->GetSendMemoryUsage() > nSendBufferMaxSize;
 
     if (it == node.vSendMsg.end()) {
         assert(node.m_send_memusage == 0);
@@ -1994,12 +2068,14 @@ bool CConnman::InactivityCheck(const CNode& node) const
     return false;
 }
 
-Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode* const> nodes)
+Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode* const> nodes, bool listening)
 {
     Sock::EventsPerSock events_per_sock;
 
-    for (const ListenSocket& hListenSocket : vhListenSocket) {
-        events_per_sock.emplace(hListenSocket.sock, Sock::Events{Sock::RECV});
+    if (listening) {
+        for (const ListenSocket& hListenSocket : vhListenSocket) {
+            events_per_sock.emplace(hListenSocket.sock, Sock::Events{Sock::RECV});
+        }
     }
 
     for (CNode* pnode : nodes) {
@@ -2011,7 +2087,7 @@ Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode* const> nodes)
             // once a potential message from vSendMsg is handed to the transport. GetBytesToSend
             // determines both of these in a single call.
             const auto& [to_send, more, _msg_type] = pnode->m_transport->GetBytesToSend(!pnode->vSendMsg.empty());
-            select_send = !to_send.empty() || more;
+            select_send = !to_send.empty() || more || !pnode->m_send_coalesced.empty();
         }
         if (!select_recv && !select_send) continue;
 
@@ -2025,32 +2101,42 @@ Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode* const> nodes)
     return events_per_sock;
 }
 
-void CConnman::SocketHandler()
+void CConnman::SocketHandler(size_t shard, SockWaitSet& wait_set)
 {
     AssertLockNotHeld(m_total_bytes_sent_mutex);
 
+    const bool listening{shard == 0};
     Sock::EventsPerSock events_per_sock;
 
     {
         const NodesSnapshot snap{*this, /*shuffle=*/false};
 
+        // A node is always serviced by the same thread, which thus owns its
+        // socket and transport for as long as it is connected.
+        std::vector<CNode*> nodes;
+        for (CNode* pnode : snap.Nodes()) {
+            if (static_cast<size_t>(pnode->GetId()) % m_num_socket_handlers == shard) {
+                nodes.push_back(pnode);
+            }
+        }
+
         const auto timeout = std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS);
 
         // Check for the readiness of the already connected sockets and the
         // listening sockets in one call ("readiness" as in poll(2) or
         // select(2)). If none are ready, wait for a short while and return
         // empty sets.
-        events_per_sock = GenerateWaitSockets(snap.Nodes());
-        if (events_per_sock.empty() || !events_per_sock.begin()->first->WaitMany(timeout, events_per_sock)) {
+        events_per_sock = GenerateWaitSockets(nodes, listening);
+        if (!wait_set.WaitMany(timeout, events_per_sock)) {
             interruptNet.sleep_for(timeout);
         }
 
         // Service (send/receive) each of the already connected nodes.
-        SocketHandlerConnected(snap.Nodes(), events_per_sock);
+        SocketHandlerConnected(nodes, events_per_sock);
     }
 
     // Accept new connections from listening sockets.
-    SocketHandlerListening(events_per_sock);
+    if (listening) SocketHandlerListening(events_per_sock);
 }
 
 void CConnman::SocketHandlerConnected(const std::vector<CNode*>& nodes,
@@ -2161,15 +2247,18 @@ void CConnman::SocketHandlerListening(const Sock::EventsPerSock& events_per_sock
     }
 }
 
-void CConnman::ThreadSocketHandler()
+void CConnman::ThreadSocketHandler(size_t shard)
 {
     AssertLockNotHeld(m_total_bytes_sent_mutex);
 
+    SockWaitSet wait_set;
     while (!interruptNet)
     {
-        DisconnectNodes();
-        NotifyNumConnectionsChanged();
-        SocketHandler();
+        if (shard == 0) {
+            DisconnectNodes();
+            NotifyNumConnectionsChanged();
+        }
+        SocketHandler(shard, wait_set);
     }
 }
 
@@ -2178,8 +2267,9 @@ void CConnman::WakeMessageHandler()
     {
         LOCK(mutexMsgProc);
         fMsgProcWake = true;
+        ++m_msg_proc_wake_seq;
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 void CConnman::ThreadDNSAddressSeed()
@@ -3001,6 +3091,31 @@ void CConnman::ThreadMessageHandler()
     }
 }
 
+void CConnman::ThreadLightMessageHandler()
+{
+    uint64_t wake_seq{WITH_LOCK(mutexMsgProc, return m_msg_proc_wake_seq)};
+
+    while (!flagInterruptMsgProc) {
+        bool more_work{false};
+
+        {
+            const NodesSnapshot snap{*this, /*shuffle=*/true};
+
+            for (CNode* pnode : snap.Nodes()) {
+                if (pnode->fDisconnect) continue;
+                more_work |= m_msgproc->ProcessLightMessages(pnode);
+                if (flagInterruptMsgProc) return;
+            }
+        }
+
+        WAIT_LOCK(mutexMsgProc, lock);
+        if (!more_work) {
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [&]() EXCLUSIVE_LOCKS_REQUIRED(mutexMsgProc) { return m_msg_proc_wake_seq != wake_seq; });
+        }
+        wake_seq = m_msg_proc_wake_seq;
+    }
+}
+
 void CConnman::ThreadI2PAcceptIncoming()
 {
     static constexpr auto err_wait_begin = 1s;
@@ -3287,7 +3402,10 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
 
     // Send and receive from sockets, accept connections
-    threadSocketHandler = std::thread(&util::TraceThread, "net", [this] { ThreadSocketHandler(); });
+    for (int shard{0}; shard < m_num_socket_handlers; ++shard) {
+        const std::string thread_name{shard == 0 ? "net" : strprintf("net.%d", shard)};
+        m_socket_handler_threads.emplace_back(&util::TraceThread, thread_name, [this, shard] { ThreadSocketHandler(shard); });
+    }
 
     if (!gArgs.GetBoolArg("-dnsseed", DEFAULT_DNSSEED))
         LogPrintf("DNS seeding disabled\n");
@@ -3313,6 +3431,9 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     // Process messages
     threadMessageHandler = std::thread(&util::TraceThread, "msghand", [this] { ThreadMessageHandler(); });
+    for (int i{0}; i < m_num_light_message_handlers; ++i) {
+        m_light_message_handler_threads.emplace_back(&util::TraceThread, strprintf("msglight.%d", i), [this] { ThreadLightMessageHandler(); });
+    }
 
     if (m_i2p_sam_session) {
         threadI2PAcceptIncoming =
@@ -3377,14 +3498,20 @@ void CConnman::StopThreads()
     }
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& thread : m_light_message_handler_threads) {
+        if (thread.joinable()) thread.join();
+    }
+    m_light_message_handler_threads.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
     if (threadDNSAddressSeed.joinable())
         threadDNSAddressSeed.join();
-    if (threadSocketHandler.joinable())
-        threadSocketHandler.join();
+    for (std::thread& thread : m_socket_handler_threads) {
+        if (thread.joinable()) thread.join();
+    }
+    m_socket_handler_threads.clear();
 }
 
 void CConnman::StopNodes()
@@ -3772,7 +3899,7 @@ void CNode::MarkReceivedMsgsForProcessing()
     for (const auto& msg : vRecvMsg) {
         // vRecvMsg contains only completed CNetMessage
         // the single possible partially deserialized message are held by TransportDeserializer
-        nSizeAdded += msg.m_raw_message_size;
+        nSizeAdded += msg.GetMemoryUsage();
     }
 
     LOCK(m_msg_process_queue_mutex);
@@ -3781,20 +3908,27 @@ void CNode::MarkReceivedMsgsForProcessing()
     fPauseRecv = m_msg_process_queue_size > m_recv_flood_size;
 }
 
-std::optional<std::pair<CNetMessage, bool>> CNode::PollMessage()
+std::optional<std::pair<CNetMessage, bool>> CNode::PollMessage(bool (*filter)(const std::string& msg_type))
 {
     LOCK(m_msg_process_queue_mutex);
     if (m_msg_process_queue.empty()) return std::nullopt;
+    if (filter && !filter(m_msg_process_queue.front().m_type)) return std::nullopt;
 
     std::list<CNetMessage> msgs;
     // Just take one message
     msgs.splice(msgs.begin(), m_msg_process_queue, m_msg_process_queue.begin());
-    m_msg_process_queue_size -= msgs.front().m_raw_message_size;
+    m_msg_process_queue_size -= msgs.front().GetMemoryUsage();
     fPauseRecv = m_msg_process_queue_size > m_recv_flood_size;
 
     return std::make_pair(std::move(msgs.front()), !m_msg_process_queue.empty());
 }
 
+bool CNode::IsNextMessage(bool (*filter)(const std::string& msg_type))
+{
+    LOCK(m_msg_process_queue_mutex);
+    return !m_msg_process_queue.empty() && filter(m_msg_process_queue.front().m_type);
+}
+
 bool CConnman::NodeFullyConnected(const CNode* pnode)
 {
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
@@ -3803,10 +3937,10 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
     AssertLockNotHeld(m_total_bytes_sent_mutex);
-    size_t nMessageSize = msg.data.size();
+    size_t nMessageSize = msg.Payload().size();
     LogDebug(BCLog::NET, "sending %s (%d bytes) peer=%d\n", msg.m_type, nMessageSize, pnode->GetId());
     if (gArgs.GetBoolArg("-capturemessages", false)) {
-        CaptureMessage(pnode->addr, msg.m_type, msg.data, /*is_incoming=*/false);
+        CaptureMessage(pnode->addr, msg.m_type, msg.Payload(), /*is_incoming=*/false);
     }
 
     TRACE6(net, outbound_message,
@@ -3814,8 +3948,8 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->m_addr_name.c_str(),
         pnode->ConnectionTypeAsString().c_str(),
         msg.m_type.c_str(),
-        msg.data.size(),
-        msg.data.data()
+        msg.Payload().size(),
+        msg.Payload().data()
     );
 
     size_t nBytesSent = 0;
@@ -3825,11 +3959,11 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         // give it a message to send.
         const auto& [to_send, more, _msg_type] =
             pnode->m_transport->GetBytesToSend(/*have_next_message=*/true);
-        const bool queue_was_empty{to_send.empty() && pnode->vSendMsg.empty()};
+        const bool queue_was_empty{to_send.empty() && pnode->vSendMsg.empty() && pnode->m_send_coalesced.empty()};
 
         // Update memory usage of send buffer.
         pnode->m_send_memusage += msg.GetMemoryUsage();
-        if (pnode->m_send_memusage + pnode->m_transport->GetSendMemoryUsage() > nSendBufferMaxSize) pnode->fPauseSend = true;
+        if (pnode->m_send_memusage + pnode->m_send_coalesced.size() + pnode->m_transport->GetSendMemoryUsage() > nSendBufferMaxSize) pnode->fPauseSend = true;
         // Move message to vSendMsg queue.
         pnode->vSendMsg.push_back(std::move(msg));
 
@@ -32,7 +32,10 @@
 #include <util/sock.h>
 #include <util/threadinterrupt.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
@@ -81,6 +84,14 @@ static const std::string DEFAULT_MAX_UPLOAD_TARGET{"0M"};
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** -sockethandlerthreads default */
+static constexpr int DEFAULT_SOCKET_HANDLER_THREADS{1};
+/** Maximum number of socket handler threads */
+static constexpr int MAX_SOCKET_HANDLER_THREADS{16};
+/** -lightmsgthreads default */
+static constexpr int DEFAULT_LIGHT_MESSAGE_THREADS{0};
+/** Maximum number of light message handler threads */
+static constexpr int MAX_LIGHT_MESSAGE_THREADS{8};
 /** Number of file descriptors required for message capture **/
 static const int NUM_FDS_MESSAGE_CAPTURE = 1;
 /** Interval for ASMap Health Check **/
@@ -91,6 +102,8 @@ static constexpr bool DEFAULT_DNSSEED{true};
 static constexpr bool DEFAULT_FIXEDSEEDS{true};
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Maximum number of bytes of small pieces collected per peer to be sent with a single system call */
+static constexpr size_t MAX_SEND_COALESCE_SIZE{8 * 1024};
 
 static constexpr bool DEFAULT_V2_TRANSPORT{true};
 
@@ -124,11 +137,21 @@ struct CSerializedNetMsg {
         CSerializedNetMsg copy;
         copy.data = data;
         copy.m_type = m_type;
+        copy.m_shared_data = m_shared_data;
         return copy;
     }
 
     std::vector<unsigned char> data;
     std::string m_type;
+    /**
+     * Immutable payload that is sent instead of `data` if set. It can be shared
+     * with other messages and caches, so that e.g. a block relayed to many peers
+     * is serialized once and queued for each of them without a copy.
+     */
+    std::shared_ptr<const std::vector<unsigned char>> m_shared_data;
+
+    /** The payload to send: `m_shared_data` if set, `data` otherwise. */
+    Span<const unsigned char> Payload() const noexcept { return m_shared_data ? Span{*m_shared_data} : Span{data}; }
 
     /** Compute total memory usage of this object (own memory + any dynamic memory). */
     size_t GetMemoryUsage() const noexcept;
@@ -227,6 +250,39 @@ public:
  * Ideally it should only contain receive time, payload,
  * type and size.
  */
+/**
+ * Pool of receive buffers shared by all connections, in power-of-two size classes.
+ *
+ * Transports take the buffer for an incoming message from the pool, and it is given
+ * back when the CNetMessage holding it is destroyed after processing. This saves an
+ * allocation (and the zeroing on free) per received message, and the repeated
+ * reallocations while a large message arrives.
+ */
+class RecvBufferPool
+{
+public:
+    //! Smallest size class
+    static constexpr size_t MIN_BUFFER_SIZE{256};
+    //! Largest size class; it fits any message up to MAX_PROTOCOL_MESSAGE_LENGTH
+    static constexpr size_t MAX_BUFFER_SIZE{4 * 1024 * 1024};
+    //! Total capacity of the idle buffers kept for reuse
+    static constexpr size_t MAX_IDLE_BYTES{16 * 1024 * 1024};
+
+    /** Get an empty buffer with room for at least `size` bytes. */
+    DataStream Get(size_t size) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Give a buffer back for reuse. It is freed if it is too small or the pool is full. */
+    void Put(DataStream&& buffer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    static constexpr size_t NUM_CLASSES{std::bit_width(MAX_BUFFER_SIZE / MIN_BUFFER_SIZE)};
+
+    Mutex m_mutex;
+    std::array<std::vector<DataStream>, NUM_CLASSES> m_idle GUARDED_BY(m_mutex);
+    size_t m_idle_bytes GUARDED_BY(m_mutex){0};
+};
+
+extern RecvBufferPool g_recv_buffer_pool;
+
 class CNetMessage
 {
 public:
@@ -237,6 +293,8 @@ public:
     std::string m_type;
 
     explicit CNetMessage(DataStream&& recv_in) : m_recv(std::move(recv_in)) {}
+    //! Returns the receive buffer to g_recv_buffer_pool.
+    ~CNetMessage();
     // Only one CNetMessage object will exist for the same message on either
     // the receive or processing queue. For performance reasons we therefore
     // delete the copy constructor and assignment operator to avoid the
@@ -245,6 +303,9 @@ public:
     CNetMessage(const CNetMessage&) = delete;
     CNetMessage& operator=(CNetMessage&&) = default;
     CNetMessage& operator=(const CNetMessage&) = delete;
+
+    /** Bytes accounted for this message in the receive queue: its wire size, or the capacity of its buffer if larger. */
+    size_t GetMemoryUsage() const noexcept { return std::max<size_t>(m_raw_message_size, m_recv.capacity()); }
 };
 
 /** The Transport converts one connection's sent messages to wire bytes, and received bytes back. */
@@ -691,6 +752,8 @@ public:
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
     /** Messages still to be fed to m_transport->SetMessageToSend. */
     std::deque<CSerializedNetMsg> vSendMsg GUARDED_BY(cs_vSend);
+    /** Bytes already taken from m_transport, to be sent ahead of its remaining bytes. */
+    std::vector<unsigned char> m_send_coalesced GUARDED_BY(cs_vSend);
     Mutex cs_vSend;
     Mutex m_sock_mutex;
     Mutex cs_vRecv;
@@ -741,10 +804,15 @@ public:
 
     /** Poll the next message from the processing queue of this connection.
      *
-     * Returns std::nullopt if the processing queue is empty, or a pair
-     * consisting of the message and a bool that indicates if the processing
-     * queue has more entries. */
-    std::optional<std::pair<CNetMessage, bool>> PollMessage()
+     * Returns std::nullopt if the processing queue is empty, or if `filter`
+     * is given and rejects the type of the next message, or a pair consisting
+     * of the message and a bool that indicates if the processing queue has
+     * more entries. */
+    std::optional<std::pair<CNetMessage, bool>> PollMessage(bool (*filter)(const std::string& msg_type) = nullptr)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_msg_process_queue_mutex);
+
+    /** Whether the processing queue of this connection starts with a message whose type `filter` accepts. */
+    bool IsNextMessage(bool (*filter)(const std::string& msg_type))
         EXCLUSIVE_LOCKS_REQUIRED(!m_msg_process_queue_mutex);
 
     /** Account for the total size of a sent message in the per msg type connection stats. */
@@ -956,7 +1024,7 @@ private:
     std::atomic<int> m_greatest_common_version{INIT_PROTO_VERSION};
 
     const size_t m_recv_flood_size;
-    std::list<CNetMessage> vRecvMsg; // Used only by SocketHandler thread
+    std::list<CNetMessage> vRecvMsg; // Used only by the node's socket handler thread
 
     Mutex m_msg_process_queue_mutex;
     std::list<CNetMessage> m_msg_process_queue GUARDED_BY(m_msg_process_queue_mutex);
@@ -1012,6 +1080,16 @@ public:
     */
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) = 0;
 
+    /**
+    * Process the next message received from a given node if it does not need
+    * g_msgproc_mutex, while the node is not processing another message. Called
+    * by the light message handler threads, concurrently with ProcessMessages().
+    *
+    * @param[in]   pnode           The node which we have received messages from.
+    * @return                      True if there is more work to be done
+    */
+    virtual bool ProcessLightMessages(CNode* pnode) = 0;
+
     /**
     * Send queued protocol messages to a given node.
     *
@@ -1044,6 +1122,8 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        int m_socket_handler_threads = DEFAULT_SOCKET_HANDLER_THREADS;
+        int m_light_message_threads = DEFAULT_LIGHT_MESSAGE_THREADS;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRangeIncoming;
         std::vector<NetWhitelistPermissions> vWhitelistedRangeOutgoing;
@@ -1078,6 +1158,8 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = std::chrono::seconds{connOptions.m_peer_connect_timeout};
+        m_num_socket_handlers = std::clamp(connOptions.m_socket_handler_threads, 1, MAX_SOCKET_HANDLER_THREADS);
+        m_num_light_message_handlers = std::clamp(connOptions.m_light_message_threads, 0, MAX_LIGHT_MESSAGE_THREADS);
         {
             LOCK(m_total_bytes_sent_mutex);
             nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
@@ -1280,6 +1362,12 @@ private:
     void ProcessAddrFetch() EXCLUSIVE_LOCKS_REQUIRED(!m_addr_fetches_mutex, !m_unused_i2p_sessions_mutex);
     void ThreadOpenConnections(std::vector<std::string> connect, Span<const std::string> seed_nodes) EXCLUSIVE_LOCKS_REQUIRED(!m_addr_fetches_mutex, !m_added_nodes_mutex, !m_nodes_mutex, !m_unused_i2p_sessions_mutex, !m_reconnections_mutex);
     void ThreadMessageHandler() EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
+    /**
+     * Process the messages that do not need g_msgproc_mutex (see
+     * NetEventsInterface::ProcessLightMessages()), so that they do not wait
+     * for the message handler thread while it validates blocks or transactions.
+     */
+    void ThreadLightMessageHandler() EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
     void ThreadI2PAcceptIncoming();
     void AcceptConnection(const ListenSocket& hListenSocket);
 
@@ -1304,14 +1392,18 @@ private:
     /**
      * Generate a collection of sockets to check for IO readiness.
      * @param[in] nodes Select from these nodes' sockets.
+     * @param[in] listening Whether to include the listening sockets.
      * @return sockets to check for readiness
      */
-    Sock::EventsPerSock GenerateWaitSockets(Span<CNode* const> nodes);
+    Sock::EventsPerSock GenerateWaitSockets(Span<CNode* const> nodes, bool listening);
 
     /**
-     * Check connected and listening sockets for IO readiness and process them accordingly.
+     * Check the connected sockets of one socket handler thread, and the listening
+     * sockets if it is the first one, for IO readiness and process them accordingly.
+     * @param[in] shard Index of the socket handler thread.
+     * @param[in] wait_set Sockets that thread waits on.
      */
-    void SocketHandler() EXCLUSIVE_LOCKS_REQUIRED(!m_total_bytes_sent_mutex, !mutexMsgProc);
+    void SocketHandler(size_t shard, SockWaitSet& wait_set) EXCLUSIVE_LOCKS_REQUIRED(!m_total_bytes_sent_mutex, !mutexMsgProc);
 
     /**
      * Do the read/write for connected sockets that are ready for IO.
@@ -1328,7 +1420,11 @@ private:
      */
     void SocketHandlerListening(const Sock::EventsPerSock& events_per_sock);
 
-    void ThreadSocketHandler() EXCLUSIVE_LOCKS_REQUIRED(!m_total_bytes_sent_mutex, !mutexMsgProc, !m_nodes_mutex, !m_reconnections_mutex);
+    /**
+     * Send and receive data for the connected nodes whose id maps to `shard`. The
+     * first socket handler thread also accepts connections and disconnects nodes.
+     */
+    void ThreadSocketHandler(size_t shard) EXCLUSIVE_LOCKS_REQUIRED(!m_total_bytes_sent_mutex, !mutexMsgProc, !m_nodes_mutex, !m_reconnections_mutex);
     void ThreadDNSAddressSeed() EXCLUSIVE_LOCKS_REQUIRED(!m_addr_fetches_mutex, !m_nodes_mutex);
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
@@ -1402,6 +1498,12 @@ private:
     // P2P timeout in seconds
     std::chrono::seconds m_peer_connect_timeout;
 
+    //! Number of socket handler threads, each serving a share of the connected nodes.
+    int m_num_socket_handlers{DEFAULT_SOCKET_HANDLER_THREADS};
+
+    //! Number of threads that process light messages next to the message handler thread.
+    int m_num_light_message_handlers{DEFAULT_LIGHT_MESSAGE_THREADS};
+
     // Whitelisted ranges. Any node connecting from these is automatically
     // whitelisted (as well as those connecting to whitelisted binds).
     std::vector<NetWhitelistPermissions> vWhitelistedRangeIncoming;
@@ -1516,6 +1618,8 @@ private:
 
     /** flag for waking the message processor. */
     bool fMsgProcWake GUARDED_BY(mutexMsgProc);
+    /** Incremented for waking the light message handler threads. */
+    uint64_t m_msg_proc_wake_seq GUARDED_BY(mutexMsgProc){0};
 
     std::condition_variable condMsgProc;
     Mutex mutexMsgProc;
@@ -1537,10 +1641,11 @@ private:
     std::unique_ptr<i2p::sam::Session> m_i2p_sam_session;
 
     std::thread threadDNSAddressSeed;
-    std::thread threadSocketHandler;
+    std::vector<std::thread> m_socket_handler_threads;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
+    std::vector<std::thread> m_light_message_handler_threads;
     std::thread threadI2PAcceptIncoming;
 
     /** flag for deciding to connect to an extra outbound peer,
@@ -23,13 +23,17 @@
 #include <netbase.h>
 #include <netmessagemaker.h>
 #include <node/blockstorage.h>
+#include <node/headers_cache.h>
+#include <node/served_block_cache.h>
 #include <node/timeoffsets.h>
+#include <node/txinventory.h>
 #include <node/txreconciliation.h>
 #include <node/warnings.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <primitives/block.h>
+#include <primitives/block_view.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <scheduler.h>
@@ -40,6 +44,7 @@
 #include <txorphanage.h>
 #include <txrequest.h>
 #include <util/check.h>
+#include <util/hasher.h>
 #include <util/strencodings.h>
 #include <util/time.h>
 #include <util/trace.h>
@@ -48,10 +53,13 @@
 #include <algorithm>
 #include <atomic>
 #include <future>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <ranges>
 #include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 using namespace util::hex_literals;
@@ -108,6 +116,14 @@ static constexpr auto GETDATA_TX_INTERVAL{60s};
 static const unsigned int MAX_GETDATA_SZ = 1000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** How much download time worth of blocks to keep in flight from a single peer, based on how fast
+ *  it has been delivering them. Slow peers get fewer blocks, so they hold up less of the download window. */
+static constexpr auto BLOCK_DOWNLOAD_TARGET_BACKLOG{10s};
+/** How long a peer must have been sending the block at the head of its queue, in multiples of its
+ *  usual delivery time, before we also request that block from a faster peer. */
+static constexpr int BLOCK_STRAGGLER_DELAY_FACTOR{3};
+/** Minimum time before we also request a block from a faster peer. */
+static constexpr auto BLOCK_STRAGGLER_DELAY_MIN{2s};
 /** Default time during which a peer must stall block download progress before being disconnected.
  * the actual timeout is increased temporarily if peers are disconnected for hitting the timeout */
 static constexpr auto BLOCK_STALLING_TIMEOUT_DEFAULT{2s};
@@ -276,10 +292,6 @@ struct Peer {
         std::unique_ptr<CBloomFilter> m_bloom_filter PT_GUARDED_BY(m_bloom_filter_mutex) GUARDED_BY(m_bloom_filter_mutex){nullptr};
 
         mutable RecursiveMutex m_tx_inventory_mutex;
-        /** A filter of all the (w)txids that the peer has announced to
-         *  us or we have announced to the peer. We use this to avoid announcing
-         *  the same (w)txid to a peer that already has the transaction. */
-        CRollingBloomFilter m_tx_inventory_known_filter GUARDED_BY(m_tx_inventory_mutex){50000, 0.000001};
         /** Set of transaction ids we still have to announce (txid for
          *  non-wtxid-relay peers, wtxid for wtxid-relay peers). We use the
          *  mempool to sort transactions in dependency order before relay, so
@@ -367,6 +379,10 @@ struct Peer {
     /** Whether we've sent this peer a getheaders in response to an inv prior to initial-headers-sync completing */
     bool m_inv_triggered_getheaders_before_sync GUARDED_BY(NetEventsInterface::g_msgproc_mutex){false};
 
+    /** Held while a message of this peer is processed, so that the light message
+     *  handler threads only process its messages in order. */
+    Mutex m_msg_process_mutex;
+
     /** Protects m_getdata_requests **/
     Mutex m_getdata_requests_mutex;
     /** Work queue of items requested by this peer **/
@@ -431,6 +447,8 @@ struct CNodeState {
     std::list<QueuedBlock> vBlocksInFlight;
     //! When the first entry in vBlocksInFlight started downloading. Don't care when vBlocksInFlight is empty.
     std::chrono::microseconds m_downloading_since{0us};
+    //! Moving average of the time this peer takes to deliver a requested block, or 0 if unknown.
+    std::chrono::microseconds m_block_delivery_time{0us};
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload{false};
     /** Whether this peer wants invs or cmpctblocks (when possible) for block announcements. */
@@ -506,6 +524,8 @@ public:
     bool HasAllDesirableServiceFlags(ServiceFlags services) const override;
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, !m_headers_presync_mutex, g_msgproc_mutex, !m_tx_download_mutex);
+    bool ProcessLightMessages(CNode* pfrom) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_tx_download_mutex);
     bool SendMessages(CNode* pto) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, !m_most_recent_block_mutex, g_msgproc_mutex, !m_tx_download_mutex);
 
@@ -532,6 +552,10 @@ public:
     ServiceFlags GetDesirableServiceFlags(ServiceFlags services) const override;
 
 private:
+    /** Process a message for which IsLightMessage() is true. Only touches atomic peer state. */
+    void ProcessLightMessage(CNode& pfrom, Peer& peer, const std::string& msg_type, DataStream& vRecv,
+                             std::chrono::microseconds time_received);
+
     /** Consider evicting an outbound peer based on the amount of time they've been behind our tip */
     void ConsiderEviction(CNode& pto, Peer& peer, std::chrono::seconds time_in_seconds) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_msgproc_mutex);
 
@@ -643,6 +667,22 @@ private:
     bool ProcessOrphanTx(Peer& peer)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex, !m_tx_download_mutex);
 
+    /** Validate a transaction received from a peer, and relay it, keep it as orphan or
+     *  record its rejection depending on the result. */
+    void ProcessTxFromPeer(CNode& pfrom, Peer& peer, const CTransactionRef& ptx)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex, cs_main, m_tx_download_mutex);
+
+    /**
+     * Validate the transactions queued for a peer, see m_tx_validation_queue.
+     *
+     * @return  True if the queue was processed or deferred, false if it was empty.
+     */
+    bool ProcessTxValidationQueue(CNode& node, Peer& peer)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex, !m_tx_download_mutex);
+
+    /** Whether another peer's next message to process is a block. */
+    bool HasBlockMessageWaiting(const CNode& node);
+
     /** Process a single headers message from a peer.
      *
      * @param[in]   pfrom     CNode of the peer
@@ -718,6 +758,8 @@ private:
         EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
 
     void SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlock& block, const BlockTransactionsRequest& req);
+    /** Same, for a block read from disk, which avoids deserializing the transactions that were not requested */
+    void SendBlockTransactions(CNode& pfrom, Peer& peer, const BlockView& block, const BlockTransactionsRequest& req);
 
     /** Register with TxRequestTracker that an INV has been received from a
      *  peer. The announcement parameters are decided in PeerManager and then
@@ -784,6 +826,46 @@ private:
     TxRequestTracker m_txrequest GUARDED_BY(m_tx_download_mutex);
     std::unique_ptr<TxReconciliationTracker> m_txreconciliation;
 
+    /** All the (w)txids that tx-relay peers have announced to us or we have
+     *  announced to them. We use this to avoid announcing the same (w)txid to
+     *  a peer that already has the transaction. */
+    node::TxInventoryKnown m_tx_inventory_known;
+
+    /** Record that a peer knows a (w)txid, if we relay transactions with it. */
+    void AddKnownTx(Peer& peer, const uint256& hash);
+
+    /** A transaction queued for announcement to at least one peer. */
+    struct TxAnnouncement {
+        GenTxid gtxid;
+        //! Number of peers with the (w)txid in TxRelay::m_tx_inventory_to_send
+        size_t peers{0};
+        //! Position in m_tx_announce_order
+        size_t rank{0};
+    };
+    /** Guards the announcement queue shared by all peers. Acquired after
+     *  TxRelay::m_tx_inventory_mutex and before TxRelay::m_bloom_filter_mutex. */
+    Mutex m_tx_announce_mutex ACQUIRED_BEFORE(m_mempool.cs);
+    /** All (w)txids in any peer's TxRelay::m_tx_inventory_to_send. */
+    std::unordered_map<uint256, TxAnnouncement, SaltedTxidHasher> m_tx_announce GUARDED_BY(m_tx_announce_mutex);
+    /** The (w)txids of m_tx_announce in the order in which to announce them (see
+     *  CTxMemPool::CompareDepthAndScore). Computed once for all peers, when
+     *  transactions have been queued since. May still contain (w)txids that
+     *  are no longer queued for any peer. */
+    std::vector<uint256> m_tx_announce_order GUARDED_BY(m_tx_announce_mutex);
+    bool m_tx_announce_order_stale GUARDED_BY(m_tx_announce_mutex){false};
+
+    /** Queue a (w)txid for announcement to a peer, if it isn't already. */
+    void QueueTxAnnouncement(Peer::TxRelay& tx_relay, const GenTxid& gtxid)
+        EXCLUSIVE_LOCKS_REQUIRED(tx_relay.m_tx_inventory_mutex, m_tx_announce_mutex);
+    /** Remove a (w)txid from a peer's announcement queue. Returns whether it was queued. */
+    bool DequeueTxAnnouncement(Peer::TxRelay& tx_relay, const uint256& hash)
+        EXCLUSIVE_LOCKS_REQUIRED(tx_relay.m_tx_inventory_mutex, m_tx_announce_mutex);
+    /** Remove all (w)txids from a peer's announcement queue. */
+    void ClearTxAnnouncements(Peer::TxRelay& tx_relay)
+        EXCLUSIVE_LOCKS_REQUIRED(tx_relay.m_tx_inventory_mutex, m_tx_announce_mutex);
+    /** Recompute m_tx_announce_order if transactions were queued since it was last computed. */
+    void UpdateTxAnnouncementOrder() EXCLUSIVE_LOCKS_REQUIRED(m_tx_announce_mutex, !m_mempool.cs);
+
     /** The height of the best chain */
     std::atomic<int> m_best_height{-1};
     /** The time of the best chain tip block */
@@ -792,11 +874,17 @@ private:
     /** Next time to check for stale tip */
     std::chrono::seconds m_stale_tip_check_time GUARDED_BY(cs_main){0s};
 
+    /** Serialized active chain headers for answering getheaders, if enabled by m_opts.headers_cache */
+    node::HeadersCache m_headers_cache GUARDED_BY(cs_main);
+
     node::Warnings& m_warnings;
     TimeOffsets m_outbound_time_offsets{m_warnings};
 
     const Options m_opts;
 
+    /** Recently served blocks, in network serialization */
+    node::ServedBlockCache m_served_block_cache{m_opts.served_block_cache_bytes};
+
     bool RejectIncomingTxs(const CNode& peer) const;
 
     /** Whether we've completed initial sync yet, for determining when to turn
@@ -986,6 +1074,19 @@ private:
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> m_most_recent_compact_block GUARDED_BY(m_most_recent_block_mutex);
     uint256 m_most_recent_block_hash GUARDED_BY(m_most_recent_block_mutex);
     std::unique_ptr<const std::map<uint256, CTransactionRef>> m_most_recent_block_txs GUARDED_BY(m_most_recent_block_mutex);
+    //! Payloads of the block, witness block and cmpctblock messages for the most recent block, built when first sent
+    std::shared_ptr<const std::vector<unsigned char>> m_most_recent_block_ser GUARDED_BY(m_most_recent_block_mutex);
+    std::shared_ptr<const std::vector<unsigned char>> m_most_recent_witness_block_ser GUARDED_BY(m_most_recent_block_mutex);
+    std::shared_ptr<const std::vector<unsigned char>> m_most_recent_compact_block_ser GUARDED_BY(m_most_recent_block_mutex);
+
+    /**
+     * Return a block (MSG_BLOCK or MSG_WITNESS_BLOCK) or cmpctblock (MSG_CMPCT_BLOCK)
+     * message for the most recent block, which shares its payload with all other
+     * peers the block is sent to in that format. Returns std::nullopt if `hash` is
+     * not the most recent block.
+     */
+    std::optional<CSerializedNetMsg> GetMostRecentBlockMsg(const uint256& hash, GetDataMsg type)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex);
 
     // Data about the low-work headers synchronization, aggregated from all peers' HeadersSyncStates.
     /** Mutex guarding the other m_headers_presync_* variables. */
@@ -1029,6 +1130,17 @@ private:
      */
     bool BlockRequested(NodeId nodeid, const CBlockIndex& block, std::list<QueuedBlock>::iterator** pit = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /** Update the delivery time estimate of a peer that sent us a block, if it is the one it was expected to send next. */
+    void RecordBlockDelivery(NodeId nodeid, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Number of blocks to keep in flight from a peer, based on how fast it delivers them. */
+    int GetBlocksInFlightLimit(const CNodeState& state) const;
+
+    /** Whether to also request a block from a peer, because the only other peer it is in flight from is
+     *  taking much longer than this one would. If so, the slow peer's delivery time estimate is raised to
+     *  the time it has spent on the block so far. */
+    bool TakeOverStraggler(NodeId nodeid, const CBlockIndex& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     bool TipMayBeStale() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
@@ -1107,6 +1219,17 @@ private:
     /** Storage for orphan information */
     TxOrphanage m_orphanage GUARDED_BY(m_tx_download_mutex);
 
+    struct TxValidationBatch {
+        std::vector<CTransactionRef> txs;
+        //! Whether the batch already waited for a block at another peer
+        bool deferred{false};
+    };
+    /** Consecutive transaction messages of each peer, up to m_opts.tx_validation_batch, that
+     *  are validated together under a single cs_main lock before the peer's next other message. */
+    std::map<NodeId, TxValidationBatch> m_tx_validation_queue GUARDED_BY(m_tx_download_mutex);
+    /** Witness hashes of the transactions in m_tx_validation_queue */
+    std::unordered_set<uint256, SaltedTxidHasher> m_queued_wtxids GUARDED_BY(m_tx_download_mutex);
+
     void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex);
 
     /** Orphan/conflicted/etc transactions that are kept for compact block reconstruction.
@@ -1223,6 +1346,18 @@ CNodeState* PeerManagerImpl::State(NodeId pnode)
  * implement BIP155 cannot receive Tor v3 addresses because it requires
  * ADDRv2 (BIP155) encoding.
  */
+/** Whether a message type carries a block that queued transactions wait for, see PeerManagerImpl::ProcessTxValidationQueue(). */
+static bool IsBlockMessage(const std::string& msg_type)
+{
+    return msg_type == NetMsgType::BLOCK || msg_type == NetMsgType::CMPCTBLOCK || msg_type == NetMsgType::BLOCKTXN;
+}
+
+/** Whether a message type can be processed without g_msgproc_mutex, see PeerManagerImpl::ProcessLightMessage(). */
+static bool IsLightMessage(const std::string& msg_type)
+{
+    return msg_type == NetMsgType::PING || msg_type == NetMsgType::PONG || msg_type == NetMsgType::FEEFILTER;
+}
+
 static bool IsAddrCompatible(const Peer& peer, const CAddress& addr)
 {
     return peer.m_wants_addrv2 || addr.IsAddrV1Compatible();
@@ -1249,13 +1384,49 @@ void PeerManagerImpl::PushAddress(Peer& peer, const CAddress& addr)
     }
 }
 
-static void AddKnownTx(Peer& peer, const uint256& hash)
+void PeerManagerImpl::AddKnownTx(Peer& peer, const uint256& hash)
 {
-    auto tx_relay = peer.GetTxRelay();
-    if (!tx_relay) return;
+    if (!peer.GetTxRelay()) return;
+    m_tx_inventory_known.Add(peer.m_id, hash);
+}
+
+void PeerManagerImpl::QueueTxAnnouncement(Peer::TxRelay& tx_relay, const GenTxid& gtxid)
+{
+    if (!tx_relay.m_tx_inventory_to_send.insert(gtxid.GetHash()).second) return;
+    auto [it, inserted]{m_tx_announce.try_emplace(gtxid.GetHash(), TxAnnouncement{.gtxid = gtxid})};
+    ++it->second.peers;
+    if (inserted) m_tx_announce_order_stale = true;
+}
+
+bool PeerManagerImpl::DequeueTxAnnouncement(Peer::TxRelay& tx_relay, const uint256& hash)
+{
+    if (!tx_relay.m_tx_inventory_to_send.erase(hash)) return false;
+    const auto it{m_tx_announce.find(hash)};
+    if (Assume(it != m_tx_announce.end()) && --it->second.peers == 0) m_tx_announce.erase(it);
+    return true;
+}
 
-    LOCK(tx_relay->m_tx_inventory_mutex);
-    tx_relay->m_tx_inventory_known_filter.insert(hash);
+void PeerManagerImpl::ClearTxAnnouncements(Peer::TxRelay& tx_relay)
+{
+    while (!tx_relay.m_tx_inventory_to_send.empty()) {
+        DequeueTxAnnouncement(tx_relay, *tx_relay.m_tx_inventory_to_send.begin());
+    }
+}
+
+void PeerManagerImpl::UpdateTxAnnouncementOrder()
+{
+    if (!m_tx_announce_order_stale) return;
+    std::vector<GenTxid> gtxids;
+    gtxids.reserve(m_tx_announce.size());
+    for (const auto& [_, announcement] : m_tx_announce) gtxids.push_back(announcement.gtxid);
+    m_mempool.SortByDepthAndScore(gtxids);
+    m_tx_announce_order.clear();
+    m_tx_announce_order.reserve(gtxids.size());
+    for (const GenTxid& gtxid : gtxids) {
+        m_tx_announce.at(gtxid.GetHash()).rank = m_tx_announce_order.size();
+        m_tx_announce_order.push_back(gtxid.GetHash());
+    }
+    m_tx_announce_order_stale = false;
 }
 
 /** Whether this peer can serve us blocks. */
@@ -1379,6 +1550,46 @@ bool PeerManagerImpl::BlockRequested(NodeId nodeid, const CBlockIndex& block, st
     return true;
 }
 
+void PeerManagerImpl::RecordBlockDelivery(NodeId nodeid, const uint256& hash)
+{
+    CNodeState* state = State(nodeid);
+    if (!state || state->vBlocksInFlight.empty() || state->vBlocksInFlight.front().pindex->GetBlockHash() != hash) return;
+    // The peer started sending this block when it finished the previous one.
+    const auto sample{GetTime<std::chrono::microseconds>() - state->m_downloading_since};
+    if (sample <= 0us) return;
+    auto& avg{state->m_block_delivery_time};
+    avg = avg == 0us ? sample : (avg * 3 + sample) / 4;
+}
+
+int PeerManagerImpl::GetBlocksInFlightLimit(const CNodeState& state) const
+{
+    if (state.m_block_delivery_time == 0us) return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    return std::clamp<int>(BLOCK_DOWNLOAD_TARGET_BACKLOG / state.m_block_delivery_time, 1, MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+bool PeerManagerImpl::TakeOverStraggler(NodeId nodeid, const CBlockIndex& block)
+{
+    const CNodeState& state{*Assert(State(nodeid))};
+    if (state.m_block_delivery_time == 0us) return false;
+
+    // Only take over blocks that a single other peer is fully downloading and has started sending.
+    const auto range{mapBlocksInFlight.equal_range(block.GetBlockHash())};
+    if (range.first == range.second || std::next(range.first) != range.second) return false;
+    const auto& [holder_id, list_it]{range.first->second};
+    if (holder_id == nodeid || list_it->partialBlock) return false;
+    CNodeState& holder{*Assert(State(holder_id))};
+    if (holder.vBlocksInFlight.begin() != list_it) return false;
+
+    const auto elapsed{GetTime<std::chrono::microseconds>() - holder.m_downloading_since};
+    if (elapsed < std::max<std::chrono::microseconds>(BLOCK_STRAGGLER_DELAY_MIN, holder.m_block_delivery_time * BLOCK_STRAGGLER_DELAY_FACTOR)) return false;
+    if (elapsed < state.m_block_delivery_time * BLOCK_STRAGGLER_DELAY_FACTOR) return false;
+
+    holder.m_block_delivery_time = std::max(holder.m_block_delivery_time, elapsed);
+    LogDebug(BCLog::NET, "Requesting block %s (%d) from peer=%d as well, peer=%d has been sending it for %d ms\n",
+             block.GetBlockHash().ToString(), block.nHeight, nodeid, holder_id, Ticks<std::chrono::milliseconds>(elapsed));
+    return true;
+}
+
 void PeerManagerImpl::MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid)
 {
     AssertLockHeld(cs_main);
@@ -1624,6 +1835,13 @@ void PeerManagerImpl::FindNextBlocks(std::vector<const CBlockIndex*>& vBlocks, c
                 if (waitingfor == -1) {
                     // This is the first already-in-flight block.
                     waitingfor = mapBlocksInFlight.lower_bound(pindex->GetBlockHash())->second.first;
+                    // It holds back the download window, so fetch it here too if its peer is lagging.
+                    if (!is_limited_peer && TakeOverStraggler(peer.m_id, *pindex)) {
+                        vBlocks.push_back(pindex);
+                        if (vBlocks.size() == count) {
+                            return;
+                        }
+                    }
                 }
                 continue;
             }
@@ -1771,6 +1989,10 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
         assert(peer != nullptr);
         m_wtxid_relay_peers -= peer->m_wtxid_relay;
         assert(m_wtxid_relay_peers >= 0);
+        if (auto tx_relay = peer->GetTxRelay()) {
+            LOCK2(tx_relay->m_tx_inventory_mutex, m_tx_announce_mutex);
+            ClearTxAnnouncements(*tx_relay);
+        }
     }
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -1793,8 +2015,13 @@ void PeerManagerImpl::FinalizeNode(const CNode& node)
         LOCK(m_tx_download_mutex);
         m_orphanage.EraseForPeer(nodeid);
         m_txrequest.DisconnectedPeer(nodeid);
+        if (auto it{m_tx_validation_queue.find(nodeid)}; it != m_tx_validation_queue.end()) {
+            for (const CTransactionRef& tx : it->second.txs) m_queued_wtxids.erase(tx->GetWitnessHash());
+            m_tx_validation_queue.erase(it);
+        }
     }
     if (m_txreconciliation) m_txreconciliation->ForgetPeer(nodeid);
+    m_tx_inventory_known.ForgetPeer(nodeid);
     m_num_preferred_download_peers -= state->fPreferredDownload;
     m_peers_downloading_from -= (!state->vBlocksInFlight.empty());
     assert(m_peers_downloading_from >= 0);
@@ -1929,6 +2156,7 @@ PeerManagerInfo PeerManagerImpl::GetInfo() const
     return PeerManagerInfo{
         .median_outbound_time_offset = m_outbound_time_offsets.Median(),
         .ignores_incoming_txs = m_opts.ignore_incoming_txs,
+        .served_block_cache = m_served_block_cache.GetStats(),
     };
 }
 
@@ -2096,6 +2324,13 @@ PeerManagerImpl::PeerManagerImpl(CConnman& connman, AddrMan& addrman,
     if (opts.reconcile_txs) {
         m_txreconciliation = std::make_unique<TxReconciliationTracker>(TXRECONCILIATION_VERSION);
     }
+
+    // Build the headers cache for the loaded chain now rather than on the
+    // first getheaders request. ActiveTipChange() keeps it up to date.
+    if (m_opts.headers_cache) {
+        LOCK(cs_main);
+        m_headers_cache.Update(m_chainman.ActiveChain());
+    }
 }
 
 void PeerManagerImpl::StartScheduledTasks(CScheduler& scheduler)
@@ -2119,6 +2354,11 @@ void PeerManagerImpl::ActiveTipChange(const CBlockIndex& new_tip, bool is_ibd)
     AssertLockNotHeld(m_mempool.cs);
     AssertLockNotHeld(m_tx_download_mutex);
 
+    if (m_opts.headers_cache) {
+        LOCK(cs_main);
+        m_headers_cache.Update(m_chainman.ActiveChain());
+    }
+
     if (!is_ibd) {
         LOCK(m_tx_download_mutex);
         // If the chain tip has changed, previously rejected transactions might now be valid, e.g. due
@@ -2204,7 +2444,7 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
 
     uint256 hashBlock(pblock->GetHash());
     const std::shared_future<CSerializedNetMsg> lazy_ser{
-        std::async(std::launch::deferred, [&] { return NetMsg::Make(NetMsgType::CMPCTBLOCK, *pcmpctblock); })};
+        std::async(std::launch::deferred, [&] { return *Assert(GetMostRecentBlockMsg(hashBlock, MSG_CMPCT_BLOCK)); })};
 
     {
         auto most_recent_block_txs = std::make_unique<std::map<uint256, CTransactionRef>>();
@@ -2218,6 +2458,9 @@ void PeerManagerImpl::NewPoWValidBlock(const CBlockIndex *pindex, const std::sha
         m_most_recent_block = pblock;
         m_most_recent_compact_block = pcmpctblock;
         m_most_recent_block_txs = std::move(most_recent_block_txs);
+        m_most_recent_block_ser.reset();
+        m_most_recent_witness_block_ser.reset();
+        m_most_recent_compact_block_ser.reset();
     }
 
     m_connman.ForEachNode([this, pindex, &lazy_ser, &hashBlock](CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(::cs_main) {
@@ -2370,7 +2613,7 @@ void PeerManagerImpl::RelayTransaction(const uint256& txid, const uint256& wtxid
         auto tx_relay = peer.GetTxRelay();
         if (!tx_relay) continue;
 
-        LOCK(tx_relay->m_tx_inventory_mutex);
+        LOCK2(tx_relay->m_tx_inventory_mutex, m_tx_announce_mutex);
         // Only queue transactions for announcement once the version handshake
         // is completed. The time of arrival for these transactions is
         // otherwise at risk of leaking to a spy, if the spy is able to
@@ -2378,9 +2621,9 @@ void PeerManagerImpl::RelayTransaction(const uint256& txid, const uint256& wtxid
         // in the announcement.
         if (tx_relay->m_next_inv_send_time == 0s) continue;
 
-        const uint256& hash{peer.m_wtxid_relay ? wtxid : txid};
-        if (!tx_relay->m_tx_inventory_known_filter.contains(hash)) {
-            tx_relay->m_tx_inventory_to_send.insert(hash);
+        const GenTxid gtxid{peer.m_wtxid_relay ? GenTxid::Wtxid(wtxid) : GenTxid::Txid(txid)};
+        if (!m_tx_inventory_known.Contains(peer.m_id, gtxid.GetHash())) {
+            QueueTxAnnouncement(*tx_relay, gtxid);
         }
     };
 }
@@ -2434,14 +2677,59 @@ void PeerManagerImpl::RelayAddress(NodeId originator,
     }
 }
 
+std::optional<CSerializedNetMsg> PeerManagerImpl::GetMostRecentBlockMsg(const uint256& hash, GetDataMsg type)
+{
+    const auto cached{[&]() EXCLUSIVE_LOCKS_REQUIRED(m_most_recent_block_mutex) -> std::shared_ptr<const std::vector<unsigned char>>& {
+        if (type == MSG_BLOCK) return m_most_recent_block_ser;
+        if (type == MSG_WITNESS_BLOCK) return m_most_recent_witness_block_ser;
+        return m_most_recent_compact_block_ser;
+    }};
+
+    CSerializedNetMsg msg;
+    msg.m_type = type == MSG_CMPCT_BLOCK ? NetMsgType::CMPCTBLOCK : NetMsgType::BLOCK;
+
+    std::shared_ptr<const CBlock> block;
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> compact_block;
+    {
+        LOCK(m_most_recent_block_mutex);
+        if (m_most_recent_block_hash != hash) return std::nullopt;
+        if (cached()) {
+            msg.m_shared_data = cached();
+            return msg;
+        }
+        block = m_most_recent_block;
+        compact_block = m_most_recent_compact_block;
+    }
+
+    // Serialize without holding the lock. If another thread does the same in the
+    // meantime, the first payload to be cached is used.
+    std::vector<unsigned char> data;
+    if (type == MSG_BLOCK) {
+        VectorWriter{data, 0, TX_NO_WITNESS(*block)};
+    } else if (type == MSG_WITNESS_BLOCK) {
+        VectorWriter{data, 0, TX_WITH_WITNESS(*block)};
+    } else {
+        VectorWriter{data, 0, *compact_block};
+    }
+    msg.m_shared_data = std::make_shared<const std::vector<unsigned char>>(std::move(data));
+
+    LOCK(m_most_recent_block_mutex);
+    if (m_most_recent_block_hash == hash) {
+        if (cached()) {
+            msg.m_shared_data = cached();
+        } else {
+            cached() = msg.m_shared_data;
+        }
+    }
+    return msg;
+}
+
 void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv& inv)
 {
     std::shared_ptr<const CBlock> a_recent_block;
-    std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
     {
         LOCK(m_most_recent_block_mutex);
         a_recent_block = m_most_recent_block;
-        a_recent_compact_block = m_most_recent_compact_block;
     }
 
     bool need_activate_chain = false;
@@ -2512,20 +2800,47 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
     std::shared_ptr<const CBlock> pblock;
     if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
-    } else if (inv.IsMsgWitnessBlk()) {
+    } else if (inv.IsMsgWitnessBlk() || inv.IsMsgBlk()) {
         // Fast-path: in this case it is possible to serve the block directly from disk,
-        // as the network format matches the format on disk
-        std::vector<uint8_t> block_data;
-        if (!m_chainman.m_blockman.ReadRawBlockFromDisk(block_data, block_pos)) {
-            if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
-                LogDebug(BCLog::NET, "Block was pruned before it could be read, disconnect peer=%s\n", pfrom.GetId());
-            } else {
-                LogError("Cannot load block from disk, disconnect peer=%d\n", pfrom.GetId());
+        // as the network format matches the format on disk. Witnesses are stripped on a
+        // BlockView, without deserializing every transaction. Recent blocks are cached in
+        // either form, as many peers tend to request the same ones. Older blocks, such as
+        // those streamed to a peer doing IBD, would only evict them and are not cached.
+        const bool witness{inv.IsMsgWitnessBlk()};
+        const bool cacheable{tip->nHeight - pindex->nHeight <= static_cast<int>(NODE_NETWORK_LIMITED_MIN_BLOCKS)};
+        node::ServedBlockCache::Data block_data{cacheable ? m_served_block_cache.Get(pindex->GetBlockHash(), witness) : nullptr};
+        if (!block_data) {
+            std::vector<uint8_t> raw_block;
+            if (!m_chainman.m_blockman.ReadRawBlockFromDisk(raw_block, block_pos)) {
+                if (WITH_LOCK(m_chainman.GetMutex(), return m_chainman.m_blockman.IsBlockPruned(*pindex))) {
+                    LogDebug(BCLog::NET, "Block was pruned before it could be read, disconnect peer=%s\n", pfrom.GetId());
+                } else {
+                    LogError("Cannot load block from disk, disconnect peer=%d\n", pfrom.GetId());
+                }
+                pfrom.fDisconnect = true;
+                return;
+            }
+            if (!witness) {
+                try {
+                    const BlockView block_view{std::move(raw_block)};
+                    raw_block.clear();
+                    VectorWriter{raw_block, 0, TX_NO_WITNESS(block_view)};
+                } catch (const std::ios_base::failure& e) {
+                    LogError("Cannot parse block from disk: %s, disconnect peer=%d\n", e.what(), pfrom.GetId());
+                    pfrom.fDisconnect = true;
+                    return;
+                }
+            }
+            block_data = std::make_shared<const std::vector<uint8_t>>(std::move(raw_block));
+            if (cacheable) {
+                m_served_block_cache.Insert(pindex->GetBlockHash(), witness, block_data);
             }
-            pfrom.fDisconnect = true;
-            return;
         }
-        MakeAndPushMessage(pfrom, NetMsgType::BLOCK, Span{block_data});
+        // The payload is shared with the cache instead of copied.
+        CSerializedNetMsg msg;
+        msg.m_type = NetMsgType::BLOCK;
+        msg.m_shared_data = std::move(block_data);
+        m_connman.PushMessage(&pfrom, std::move(msg));
         // Don't set pblock as we've sent the block
     } else {
         // Send block from disk
@@ -2542,10 +2857,15 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
         pblock = pblockRead;
     }
     if (pblock) {
-        if (inv.IsMsgBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_NO_WITNESS(*pblock));
-        } else if (inv.IsMsgWitnessBlk()) {
-            MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
+        if (inv.IsMsgBlk() || inv.IsMsgWitnessBlk()) {
+            // Only the most recent block is sent from memory in these formats.
+            if (auto msg{GetMostRecentBlockMsg(pindex->GetBlockHash(), inv.IsMsgWitnessBlk() ? MSG_WITNESS_BLOCK : MSG_BLOCK)}) {
+                m_connman.PushMessage(&pfrom, std::move(*msg));
+            } else if (inv.IsMsgBlk()) {
+                MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_NO_WITNESS(*pblock));
+            } else {
+                MakeAndPushMessage(pfrom, NetMsgType::BLOCK, TX_WITH_WITNESS(*pblock));
+            }
         } else if (inv.IsMsgFilteredBlk()) {
             bool sendMerkleBlock = false;
             CMerkleBlock merkleBlock;
@@ -2576,8 +2896,8 @@ void PeerManagerImpl::ProcessGetBlockData(CNode& pfrom, Peer& peer, const CInv&
             // and we don't feel like constructing the object for them, so
             // instead we respond with the full, non-compact block.
             if (can_direct_fetch && pindex->nHeight >= tip->nHeight - MAX_CMPCTBLOCK_DEPTH) {
-                if (a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                    MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, *a_recent_compact_block);
+                if (auto msg{GetMostRecentBlockMsg(pindex->GetBlockHash(), MSG_CMPCT_BLOCK)}) {
+                    m_connman.PushMessage(&pfrom, std::move(*msg));
                 } else {
                     CBlockHeaderAndShortTxIDs cmpctblock{*pblock, m_rng.rand64()};
                     MakeAndPushMessage(pfrom, NetMsgType::CMPCTBLOCK, cmpctblock);
@@ -2715,6 +3035,21 @@ void PeerManagerImpl::SendBlockTransactions(CNode& pfrom, Peer& peer, const CBlo
     MakeAndPushMessage(pfrom, NetMsgType::BLOCKTXN, resp);
 }
 
+void PeerManagerImpl::SendBlockTransactions(CNode& pfrom, Peer& peer, const BlockView& block, const BlockTransactionsRequest& req)
+{
+    // Same wire format as BlockTransactions, with each transaction copied from the block as serialized.
+    std::vector<TxView> txn(req.indexes.size());
+    for (size_t i = 0; i < req.indexes.size(); i++) {
+        if (req.indexes[i] >= block.Transactions().size()) {
+            Misbehaving(peer, "getblocktxn with out-of-bounds tx indices");
+            return;
+        }
+        txn[i] = block.Transactions()[req.indexes[i]];
+    }
+
+    MakeAndPushMessage(pfrom, NetMsgType::BLOCKTXN, req.blockhash, TX_WITH_WITNESS(txn));
+}
+
 bool PeerManagerImpl::CheckHeadersPoW(const std::vector<CBlockHeader>& headers, const Consensus::Params& consensusParams, Peer& peer)
 {
     // Do these headers have proof-of-work matching what's claimed?
@@ -3410,6 +3745,213 @@ std::optional<PeerManagerImpl::PackageToValidate> PeerManagerImpl::Find1P1CPacka
     return std::nullopt;
 }
 
+void PeerManagerImpl::ProcessTxFromPeer(CNode& pfrom, Peer& peer, const CTransactionRef& ptx)
+{
+    AssertLockHeld(g_msgproc_mutex);
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_tx_download_mutex);
+
+    const CTransaction& tx = *ptx;
+    const uint256& txid = ptx->GetHash();
+    const uint256& wtxid = ptx->GetWitnessHash();
+
+    // We do the AlreadyHaveTx() check using wtxid, rather than txid - in the
+    // absence of witness malleation, this is strictly better, because the
+    // recent rejects filter may contain the wtxid but rarely contains
+    // the txid of a segwit transaction that has been rejected.
+    // In the presence of witness malleation, it's possible that by only
+    // doing the check with wtxid, we could overlook a transaction which
+    // was confirmed with a different witness, or exists in our mempool
+    // with a different witness, but this has limited downside:
+    // mempool validation does its own lookup of whether we have the txid
+    // already; and an adversary can already relay us old transactions
+    // (older than our recency filter) if trying to DoS us, without any need
+    // for witness malleation.
+    if (AlreadyHaveTx(GenTxid::Wtxid(wtxid), /*include_reconsiderable=*/true)) {
+        if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
+            // Always relay transactions received from peers with forcerelay
+            // permission, even if they were already in the mempool, allowing
+            // the node to function as a gateway for nodes hidden behind it.
+            if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
+                LogPrintf("Not relaying non-mempool transaction %s (wtxid=%s) from forcerelay peer=%d\n",
+                          tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
+            } else {
+                LogPrintf("Force relaying tx %s (wtxid=%s) from peer=%d\n",
+                          tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
+                RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
+            }
+        }
+
+        if (RecentRejectsReconsiderableFilter().contains(wtxid)) {
+            // When a transaction is already in m_lazy_recent_rejects_reconsiderable, we shouldn't submit
+            // it by itself again. However, look for a matching child in the orphanage, as it is
+            // possible that they succeed as a package.
+            LogDebug(BCLog::TXPACKAGES, "found tx %s (wtxid=%s) in reconsiderable rejects, looking for child in orphanage\n",
+                     txid.ToString(), wtxid.ToString());
+            if (auto package_to_validate{Find1P1CPackage(ptx, pfrom.GetId())}) {
+                const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
+                LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
+                         package_result.m_state.IsValid() ? "package accepted" : "package rejected");
+                ProcessPackageResult(package_to_validate.value(), package_result);
+            }
+        }
+        // If a tx is detected by m_lazy_recent_rejects it is ignored. Because we haven't
+        // submitted the tx to our mempool, we won't have computed a DoS
+        // score for it or determined exactly why we consider it invalid.
+        //
+        // This means we won't penalize any peer subsequently relaying a DoSy
+        // tx (even if we penalized the first peer who gave it to us) because
+        // we have to account for m_lazy_recent_rejects showing false positives. In
+        // other words, we shouldn't penalize a peer if we aren't *sure* they
+        // submitted a DoSy tx.
+        //
+        // Note that m_lazy_recent_rejects doesn't just record DoSy or invalid
+        // transactions, but any tx not accepted by the mempool, which may be
+        // due to node policy (vs. consensus). So we can't blanket penalize a
+        // peer simply for relaying a tx that our m_lazy_recent_rejects has caught,
+        // regardless of false positives.
+        return;
+    }
+
+    const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
+    const TxValidationState& state = result.m_state;
+
+    if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+        ProcessValidTx(pfrom.GetId(), ptx, result.m_replaced_transactions);
+        pfrom.m_last_tx_time = GetTime<std::chrono::seconds>();
+    }
+    else if (state.GetResult() == TxValidationResult::TX_MISSING_INPUTS)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+
+        // Deduplicate parent txids, so that we don't have to loop over
+        // the same parent txid more than once down below.
+        std::vector<uint256> unique_parents;
+        unique_parents.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            // We start with all parents, and then remove duplicates below.
+            unique_parents.push_back(txin.prevout.hash);
+        }
+        std::sort(unique_parents.begin(), unique_parents.end());
+        unique_parents.erase(std::unique(unique_parents.begin(), unique_parents.end()), unique_parents.end());
+
+        // Distinguish between parents in m_lazy_recent_rejects and m_lazy_recent_rejects_reconsiderable.
+        // We can tolerate having up to 1 parent in m_lazy_recent_rejects_reconsiderable since we
+        // submit 1p1c packages. However, fail immediately if any are in m_lazy_recent_rejects.
+        std::optional<uint256> rejected_parent_reconsiderable;
+        for (const uint256& parent_txid : unique_parents) {
+            if (RecentRejectsFilter().contains(parent_txid)) {
+                fRejectedParents = true;
+                break;
+            } else if (RecentRejectsReconsiderableFilter().contains(parent_txid) && !m_mempool.exists(GenTxid::Txid(parent_txid))) {
+                // More than 1 parent in m_lazy_recent_rejects_reconsiderable: 1p1c will not be
+                // sufficient to accept this package, so just give up here.
+                if (rejected_parent_reconsiderable.has_value()) {
+                    fRejectedParents = true;
+                    break;
+                }
+                rejected_parent_reconsiderable = parent_txid;
+            }
+        }
+        if (!fRejectedParents) {
+            const auto current_time{GetTime<std::chrono::microseconds>()};
+
+            for (const uint256& parent_txid : unique_parents) {
+                // Here, we only have the txid (and not wtxid) of the
+                // inputs, so we only request in txid mode, even for
+                // wtxidrelay peers.
+                // Eventually we should replace this with an improved
+                // protocol for getting all unconfirmed parents.
+                const auto gtxid{GenTxid::Txid(parent_txid)};
+                AddKnownTx(peer, parent_txid);
+                // Exclude m_lazy_recent_rejects_reconsiderable: the missing parent may have been
+                // previously rejected for being too low feerate. This orphan might CPFP it.
+                if (!AlreadyHaveTx(gtxid, /*include_reconsiderable=*/false)) AddTxAnnouncement(pfrom, gtxid, current_time);
+            }
+
+            if (m_orphanage.AddTx(ptx, pfrom.GetId())) {
+                AddToCompactExtraTransactions(ptx);
+            }
+
+            // Once added to the orphan pool, a tx is considered AlreadyHave, and we shouldn't request it anymore.
+            m_txrequest.ForgetTxHash(tx.GetHash());
+            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+
+            // DoS prevention: do not allow m_orphanage to grow unbounded (see CVE-2012-3789)
+            m_orphanage.LimitOrphans(m_opts.max_orphan_txs, m_rng);
+        } else {
+            LogDebug(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s (wtxid=%s)\n",
+                     tx.GetHash().ToString(),
+                     tx.GetWitnessHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            // Here we add both the txid and the wtxid, as we know that
+            // regardless of what witness is provided, we will not accept
+            // this, so we don't need to allow for redownload of this txid
+            // from any of our non-wtxidrelay peers.
+            RecentRejectsFilter().insert(tx.GetHash().ToUint256());
+            RecentRejectsFilter().insert(tx.GetWitnessHash().ToUint256());
+            m_txrequest.ForgetTxHash(tx.GetHash());
+            m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+        }
+    }
+    if (state.IsInvalid()) {
+        ProcessInvalidTx(pfrom.GetId(), ptx, state, /*maybe_add_extra_compact_tx=*/true);
+    }
+    // When a transaction fails for TX_RECONSIDERABLE, look for a matching child in the
+    // orphanage, as it is possible that they succeed as a package.
+    if (state.GetResult() == TxValidationResult::TX_RECONSIDERABLE) {
+        LogDebug(BCLog::TXPACKAGES, "tx %s (wtxid=%s) failed but reconsiderable, looking for child in orphanage\n",
+                 txid.ToString(), wtxid.ToString());
+        if (auto package_to_validate{Find1P1CPackage(ptx, pfrom.GetId())}) {
+            const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
+            LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
+                     package_result.m_state.IsValid() ? "package accepted" : "package rejected");
+            ProcessPackageResult(package_to_validate.value(), package_result);
+        }
+    }
+}
+
+bool PeerManagerImpl::ProcessTxValidationQueue(CNode& node, Peer& peer)
+{
+    AssertLockHeld(g_msgproc_mutex);
+    bool deferred;
+    {
+        LOCK(m_tx_download_mutex);
+        const auto it{m_tx_validation_queue.find(peer.m_id)};
+        if (it == m_tx_validation_queue.end()) return false;
+        deferred = it->second.deferred;
+    }
+    // Let a block waiting at another peer go first, once per batch, which is
+    // enough for that peer's turn in the message handler to come.
+    if (!deferred && HasBlockMessageWaiting(node)) {
+        LOCK(m_tx_download_mutex);
+        if (auto it{m_tx_validation_queue.find(peer.m_id)}; it != m_tx_validation_queue.end()) it->second.deferred = true;
+        return true;
+    }
+
+    LOCK2(cs_main, m_tx_download_mutex);
+    auto it{m_tx_validation_queue.find(peer.m_id)};
+    if (it == m_tx_validation_queue.end()) return false;
+    const std::vector<CTransactionRef> txs{std::move(it->second.txs)};
+    m_tx_validation_queue.erase(it);
+    for (const CTransactionRef& ptx : txs) {
+        m_queued_wtxids.erase(ptx->GetWitnessHash());
+        ProcessTxFromPeer(node, peer, ptx);
+    }
+    return true;
+}
+
+bool PeerManagerImpl::HasBlockMessageWaiting(const CNode& node)
+{
+    bool waiting{false};
+    m_connman.ForEachNode([&](CNode* other) {
+        // A peer whose send buffer is full doesn't get its messages processed.
+        if (other != &node && !other->fPauseSend && other->IsNextMessage(IsBlockMessage)) waiting = true;
+    });
+    return waiting;
+}
+
 bool PeerManagerImpl::ProcessOrphanTx(Peer& peer)
 {
     AssertLockHeld(g_msgproc_mutex);
@@ -3712,6 +4254,102 @@ void PeerManagerImpl::ProcessCompactBlockTxns(CNode& pfrom, Peer& peer, const Bl
     return;
 }
 
+void PeerManagerImpl::ProcessLightMessage(CNode& pfrom, Peer& peer, const std::string& msg_type, DataStream& vRecv,
+                                          const std::chrono::microseconds time_received)
+{
+    if (msg_type == NetMsgType::PING) {
+        if (pfrom.GetCommonVersion() > BIP0031_VERSION) {
+            uint64_t nonce = 0;
+            vRecv >> nonce;
+            // Echo the message back with the nonce. This allows for two useful features:
+            //
+            // 1) A remote node can quickly check if the connection is operational
+            // 2) Remote nodes can measure the latency of the network thread. If this node
+            //    is overloaded it won't respond to pings quickly and the remote node can
+            //    avoid sending us more work, like chain download requests.
+            //
+            // The nonce stops the remote getting confused between different pings: without
+            // it, if the remote node sends a ping once per second and this node takes 5
+            // seconds to respond to each, the 5th ping the remote sends would appear to
+            // return very quickly.
+            MakeAndPushMessage(pfrom, NetMsgType::PONG, nonce);
+        }
+        return;
+    }
+
+    if (msg_type == NetMsgType::PONG) {
+        const auto ping_end = time_received;
+        uint64_t nonce = 0;
+        size_t nAvail = vRecv.in_avail();
+        bool bPingFinished = false;
+        std::string sProblem;
+
+        // The light message handler threads may process this concurrently with
+        // MaybeSendPing(), so read the expected nonce once.
+        uint64_t nonce_sent{peer.m_ping_nonce_sent};
+
+        if (nAvail >= sizeof(nonce)) {
+            vRecv >> nonce;
+
+            // Only process pong message if there is an outstanding ping (old ping without nonce should never pong)
+            if (nonce_sent != 0) {
+                if (nonce == nonce_sent) {
+                    // Matching pong received, this ping is no longer outstanding
+                    bPingFinished = true;
+                    const auto ping_time = ping_end - peer.m_ping_start.load();
+                    if (ping_time.count() >= 0) {
+                        // Let connman know about this successful ping-pong
+                        pfrom.PongReceived(ping_time);
+                    } else {
+                        // This should never happen
+                        sProblem = "Timing mishap";
+                    }
+                } else {
+                    // Nonce mismatches are normal when pings are overlapping
+                    sProblem = "Nonce mismatch";
+                    if (nonce == 0) {
+                        // This is most likely a bug in another implementation somewhere; cancel this ping
+                        bPingFinished = true;
+                        sProblem = "Nonce zero";
+                    }
+                }
+            } else {
+                sProblem = "Unsolicited pong without ping";
+            }
+        } else {
+            // This is most likely a bug in another implementation somewhere; cancel this ping
+            bPingFinished = true;
+            sProblem = "Short payload";
+        }
+
+        if (!(sProblem.empty())) {
+            LogDebug(BCLog::NET, "pong peer=%d: %s, %x expected, %x received, %u bytes\n",
+                pfrom.GetId(),
+                sProblem,
+                nonce_sent,
+                nonce,
+                nAvail);
+        }
+        if (bPingFinished) {
+            // Leave a ping that was sent in the meantime outstanding.
+            peer.m_ping_nonce_sent.compare_exchange_strong(nonce_sent, 0);
+        }
+        return;
+    }
+
+    if (msg_type == NetMsgType::FEEFILTER) {
+        CAmount newFeeFilter = 0;
+        vRecv >> newFeeFilter;
+        if (MoneyRange(newFeeFilter)) {
+            if (auto tx_relay = peer.GetTxRelay(); tx_relay != nullptr) {
+                tx_relay->m_fee_filter_received = newFeeFilter;
+            }
+            LogDebug(BCLog::NET, "received: feefilter of %s from peer=%d\n", CFeeRate(newFeeFilter).ToString(), pfrom.GetId());
+        }
+        return;
+    }
+}
+
 void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type, DataStream& vRecv,
                                      const std::chrono::microseconds time_received,
                                      const std::atomic<bool>& interruptMsgProc)
@@ -4433,13 +5071,17 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         }
 
         if (!block_pos.IsNull()) {
-            CBlock block;
-            const bool ret{m_chainman.m_blockman.ReadBlockFromDisk(block, block_pos)};
+            std::vector<uint8_t> raw_block;
+            const bool ret{m_chainman.m_blockman.ReadRawBlockFromDisk(raw_block, block_pos)};
             // If height is above MAX_BLOCKTXN_DEPTH then this block cannot get
             // pruned after we release cs_main above, so this read should never fail.
             assert(ret);
 
-            SendBlockTransactions(pfrom, *peer, block, req);
+            try {
+                SendBlockTransactions(pfrom, *peer, BlockView{std::move(raw_block)}, req);
+            } catch (const std::ios_base::failure& e) {
+                LogError("Cannot parse block %s from disk: %s\n", req.blockhash.ToString(), e.what());
+            }
             return;
         }
 
@@ -4514,10 +5156,29 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
                 pindex = m_chainman.ActiveChain().Next(pindex);
         }
 
+        LogDebug(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom.GetId());
+        const CChain& active_chain{m_chainman.ActiveChain()};
+        if (m_opts.headers_cache && pindex && active_chain.Contains(pindex)) {
+            // Serve the whole range as one slice of the serialized active chain,
+            // stopping at the same header as the loop below would. Like the
+            // loop, this sends at least one header even with a limit of 0.
+            const int max_headers{static_cast<int>(std::clamp<uint32_t>(m_opts.max_headers_result, 1, std::numeric_limits<int>::max()))};
+            int count{std::min(active_chain.Height() - pindex->nHeight + 1, max_headers)};
+            const CBlockIndex* stop{hashStop.IsNull() ? nullptr : m_chainman.m_blockman.LookupBlockIndex(hashStop)};
+            if (stop && stop->nHeight >= pindex->nHeight && active_chain.Contains(stop)) {
+                count = std::min(count, stop->nHeight - pindex->nHeight + 1);
+            }
+            // Normally a no-op, as the cache follows tip changes.
+            m_headers_cache.Update(active_chain);
+            // See below for why pindexBestHeaderSent is reset.
+            nodestate->pindexBestHeaderSent = active_chain[pindex->nHeight + count - 1];
+            MakeAndPushMessage(pfrom, NetMsgType::HEADERS, COMPACTSIZE(uint64_t(count)), m_headers_cache.GetHeaders(pindex->nHeight, count));
+            return;
+        }
+
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = m_opts.max_headers_result;
-        LogDebug(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom.GetId());
         for (; pindex; pindex = m_chainman.ActiveChain().Next(pindex))
         {
             vHeaders.emplace_back(pindex->GetBlockHeader());
@@ -4563,167 +5224,22 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         const uint256& hash = peer->m_wtxid_relay ? wtxid : txid;
         AddKnownTx(*peer, hash);
 
-        LOCK2(cs_main, m_tx_download_mutex);
-
-        m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
-        if (tx.HasWitness()) m_txrequest.ReceivedResponse(pfrom.GetId(), wtxid);
-
-        // We do the AlreadyHaveTx() check using wtxid, rather than txid - in the
-        // absence of witness malleation, this is strictly better, because the
-        // recent rejects filter may contain the wtxid but rarely contains
-        // the txid of a segwit transaction that has been rejected.
-        // In the presence of witness malleation, it's possible that by only
-        // doing the check with wtxid, we could overlook a transaction which
-        // was confirmed with a different witness, or exists in our mempool
-        // with a different witness, but this has limited downside:
-        // mempool validation does its own lookup of whether we have the txid
-        // already; and an adversary can already relay us old transactions
-        // (older than our recency filter) if trying to DoS us, without any need
-        // for witness malleation.
-        if (AlreadyHaveTx(GenTxid::Wtxid(wtxid), /*include_reconsiderable=*/true)) {
-            if (pfrom.HasPermission(NetPermissionFlags::ForceRelay)) {
-                // Always relay transactions received from peers with forcerelay
-                // permission, even if they were already in the mempool, allowing
-                // the node to function as a gateway for nodes hidden behind it.
-                if (!m_mempool.exists(GenTxid::Txid(tx.GetHash()))) {
-                    LogPrintf("Not relaying non-mempool transaction %s (wtxid=%s) from forcerelay peer=%d\n",
-                              tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
-                } else {
-                    LogPrintf("Force relaying tx %s (wtxid=%s) from peer=%d\n",
-                              tx.GetHash().ToString(), tx.GetWitnessHash().ToString(), pfrom.GetId());
-                    RelayTransaction(tx.GetHash(), tx.GetWitnessHash());
-                }
-            }
-
-            if (RecentRejectsReconsiderableFilter().contains(wtxid)) {
-                // When a transaction is already in m_lazy_recent_rejects_reconsiderable, we shouldn't submit
-                // it by itself again. However, look for a matching child in the orphanage, as it is
-                // possible that they succeed as a package.
-                LogDebug(BCLog::TXPACKAGES, "found tx %s (wtxid=%s) in reconsiderable rejects, looking for child in orphanage\n",
-                         txid.ToString(), wtxid.ToString());
-                if (auto package_to_validate{Find1P1CPackage(ptx, pfrom.GetId())}) {
-                    const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
-                    LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
-                             package_result.m_state.IsValid() ? "package accepted" : "package rejected");
-                    ProcessPackageResult(package_to_validate.value(), package_result);
-                }
-            }
-            // If a tx is detected by m_lazy_recent_rejects it is ignored. Because we haven't
-            // submitted the tx to our mempool, we won't have computed a DoS
-            // score for it or determined exactly why we consider it invalid.
-            //
-            // This means we won't penalize any peer subsequently relaying a DoSy
-            // tx (even if we penalized the first peer who gave it to us) because
-            // we have to account for m_lazy_recent_rejects showing false positives. In
-            // other words, we shouldn't penalize a peer if we aren't *sure* they
-            // submitted a DoSy tx.
-            //
-            // Note that m_lazy_recent_rejects doesn't just record DoSy or invalid
-            // transactions, but any tx not accepted by the mempool, which may be
-            // due to node policy (vs. consensus). So we can't blanket penalize a
-            // peer simply for relaying a tx that our m_lazy_recent_rejects has caught,
-            // regardless of false positives.
+        if (m_opts.tx_validation_batch > 1) {
+            LOCK(m_tx_download_mutex);
+            m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+            if (tx.HasWitness()) m_txrequest.ReceivedResponse(pfrom.GetId(), wtxid);
+            // A copy from another peer is dropped while the first one waits, as
+            // it would be by AlreadyHaveTx() once the first one is validated.
+            if (m_queued_wtxids.insert(wtxid).second) m_tx_validation_queue[pfrom.GetId()].txs.push_back(ptx);
             return;
         }
 
-        const MempoolAcceptResult result = m_chainman.ProcessTransaction(ptx);
-        const TxValidationState& state = result.m_state;
-
-        if (result.m_result_type == MempoolAcceptResult::ResultType::VALID) {
-            ProcessValidTx(pfrom.GetId(), ptx, result.m_replaced_transactions);
-            pfrom.m_last_tx_time = GetTime<std::chrono::seconds>();
-        }
-        else if (state.GetResult() == TxValidationResult::TX_MISSING_INPUTS)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-
-            // Deduplicate parent txids, so that we don't have to loop over
-            // the same parent txid more than once down below.
-            std::vector<uint256> unique_parents;
-            unique_parents.reserve(tx.vin.size());
-            for (const CTxIn& txin : tx.vin) {
-                // We start with all parents, and then remove duplicates below.
-                unique_parents.push_back(txin.prevout.hash);
-            }
-            std::sort(unique_parents.begin(), unique_parents.end());
-            unique_parents.erase(std::unique(unique_parents.begin(), unique_parents.end()), unique_parents.end());
-
-            // Distinguish between parents in m_lazy_recent_rejects and m_lazy_recent_rejects_reconsiderable.
-            // We can tolerate having up to 1 parent in m_lazy_recent_rejects_reconsiderable since we
-            // submit 1p1c packages. However, fail immediately if any are in m_lazy_recent_rejects.
-            std::optional<uint256> rejected_parent_reconsiderable;
-            for (const uint256& parent_txid : unique_parents) {
-                if (RecentRejectsFilter().contains(parent_txid)) {
-                    fRejectedParents = true;
-                    break;
-                } else if (RecentRejectsReconsiderableFilter().contains(parent_txid) && !m_mempool.exists(GenTxid::Txid(parent_txid))) {
-                    // More than 1 parent in m_lazy_recent_rejects_reconsiderable: 1p1c will not be
-                    // sufficient to accept this package, so just give up here.
-                    if (rejected_parent_reconsiderable.has_value()) {
-                        fRejectedParents = true;
-                        break;
-                    }
-                    rejected_parent_reconsiderable = parent_txid;
-                }
-            }
-            if (!fRejectedParents) {
-                const auto current_time{GetTime<std::chrono::microseconds>()};
-
-                for (const uint256& parent_txid : unique_parents) {
-                    // Here, we only have the txid (and not wtxid) of the
-                    // inputs, so we only request in txid mode, even for
-                    // wtxidrelay peers.
-                    // Eventually we should replace this with an improved
-                    // protocol for getting all unconfirmed parents.
-                    const auto gtxid{GenTxid::Txid(parent_txid)};
-                    AddKnownTx(*peer, parent_txid);
-                    // Exclude m_lazy_recent_rejects_reconsiderable: the missing parent may have been
-                    // previously rejected for being too low feerate. This orphan might CPFP it.
-                    if (!AlreadyHaveTx(gtxid, /*include_reconsiderable=*/false)) AddTxAnnouncement(pfrom, gtxid, current_time);
-                }
-
-                if (m_orphanage.AddTx(ptx, pfrom.GetId())) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-
-                // Once added to the orphan pool, a tx is considered AlreadyHave, and we shouldn't request it anymore.
-                m_txrequest.ForgetTxHash(tx.GetHash());
-                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
+        LOCK2(cs_main, m_tx_download_mutex);
 
-                // DoS prevention: do not allow m_orphanage to grow unbounded (see CVE-2012-3789)
-                m_orphanage.LimitOrphans(m_opts.max_orphan_txs, m_rng);
-            } else {
-                LogDebug(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s (wtxid=%s)\n",
-                         tx.GetHash().ToString(),
-                         tx.GetWitnessHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                // Here we add both the txid and the wtxid, as we know that
-                // regardless of what witness is provided, we will not accept
-                // this, so we don't need to allow for redownload of this txid
-                // from any of our non-wtxidrelay peers.
-                RecentRejectsFilter().insert(tx.GetHash().ToUint256());
-                RecentRejectsFilter().insert(tx.GetWitnessHash().ToUint256());
-                m_txrequest.ForgetTxHash(tx.GetHash());
-                m_txrequest.ForgetTxHash(tx.GetWitnessHash());
-            }
-        }
-        if (state.IsInvalid()) {
-            ProcessInvalidTx(pfrom.GetId(), ptx, state, /*maybe_add_extra_compact_tx=*/true);
-        }
-        // When a transaction fails for TX_RECONSIDERABLE, look for a matching child in the
-        // orphanage, as it is possible that they succeed as a package.
-        if (state.GetResult() == TxValidationResult::TX_RECONSIDERABLE) {
-            LogDebug(BCLog::TXPACKAGES, "tx %s (wtxid=%s) failed but reconsiderable, looking for child in orphanage\n",
-                     txid.ToString(), wtxid.ToString());
-            if (auto package_to_validate{Find1P1CPackage(ptx, pfrom.GetId())}) {
-                const auto package_result{ProcessNewPackage(m_chainman.ActiveChainstate(), m_mempool, package_to_validate->m_txns, /*test_accept=*/false, /*client_maxfeerate=*/std::nullopt)};
-                LogDebug(BCLog::TXPACKAGES, "package evaluation for %s: %s\n", package_to_validate->ToString(),
-                         package_result.m_state.IsValid() ? "package accepted" : "package rejected");
-                ProcessPackageResult(package_to_validate.value(), package_result);
-            }
-        }
+        m_txrequest.ReceivedResponse(pfrom.GetId(), txid);
+        if (tx.HasWitness()) m_txrequest.ReceivedResponse(pfrom.GetId(), wtxid);
 
+        ProcessTxFromPeer(pfrom, *peer, ptx);
         return;
     }
 
@@ -5061,6 +5577,7 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
             // Always process the block if we requested it, since we may
             // need it even when it's not a candidate for a new best tip.
             forceProcessing = IsBlockRequested(hash);
+            RecordBlockDelivery(pfrom.GetId(), hash);
             RemoveBlockRequest(hash, pfrom.GetId());
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
@@ -5142,78 +5659,8 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
-    if (msg_type == NetMsgType::PING) {
-        if (pfrom.GetCommonVersion() > BIP0031_VERSION) {
-            uint64_t nonce = 0;
-            vRecv >> nonce;
-            // Echo the message back with the nonce. This allows for two useful features:
-            //
-            // 1) A remote node can quickly check if the connection is operational
-            // 2) Remote nodes can measure the latency of the network thread. If this node
-            //    is overloaded it won't respond to pings quickly and the remote node can
-            //    avoid sending us more work, like chain download requests.
-            //
-            // The nonce stops the remote getting confused between different pings: without
-            // it, if the remote node sends a ping once per second and this node takes 5
-            // seconds to respond to each, the 5th ping the remote sends would appear to
-            // return very quickly.
-            MakeAndPushMessage(pfrom, NetMsgType::PONG, nonce);
-        }
-        return;
-    }
-
-    if (msg_type == NetMsgType::PONG) {
-        const auto ping_end = time_received;
-        uint64_t nonce = 0;
-        size_t nAvail = vRecv.in_avail();
-        bool bPingFinished = false;
-        std::string sProblem;
-
-        if (nAvail >= sizeof(nonce)) {
-            vRecv >> nonce;
-
-            // Only process pong message if there is an outstanding ping (old ping without nonce should never pong)
-            if (peer->m_ping_nonce_sent != 0) {
-                if (nonce == peer->m_ping_nonce_sent) {
-                    // Matching pong received, this ping is no longer outstanding
-                    bPingFinished = true;
-                    const auto ping_time = ping_end - peer->m_ping_start.load();
-                    if (ping_time.count() >= 0) {
-                        // Let connman know about this successful ping-pong
-                        pfrom.PongReceived(ping_time);
-                    } else {
-                        // This should never happen
-                        sProblem = "Timing mishap";
-                    }
-                } else {
-                    // Nonce mismatches are normal when pings are overlapping
-                    sProblem = "Nonce mismatch";
-                    if (nonce == 0) {
-                        // This is most likely a bug in another implementation somewhere; cancel this ping
-                        bPingFinished = true;
-                        sProblem = "Nonce zero";
-                    }
-                }
-            } else {
-                sProblem = "Unsolicited pong without ping";
-            }
-        } else {
-            // This is most likely a bug in another implementation somewhere; cancel this ping
-            bPingFinished = true;
-            sProblem = "Short payload";
-        }
-
-        if (!(sProblem.empty())) {
-            LogDebug(BCLog::NET, "pong peer=%d: %s, %x expected, %x received, %u bytes\n",
-                pfrom.GetId(),
-                sProblem,
-                peer->m_ping_nonce_sent,
-                nonce,
-                nAvail);
-        }
-        if (bPingFinished) {
-            peer->m_ping_nonce_sent = 0;
-        }
+    if (IsLightMessage(msg_type)) {
+        ProcessLightMessage(pfrom, *peer, msg_type, vRecv, time_received);
         return;
     }
 
@@ -5289,18 +5736,6 @@ void PeerManagerImpl::ProcessMessage(CNode& pfrom, const std::string& msg_type,
         return;
     }
 
-    if (msg_type == NetMsgType::FEEFILTER) {
-        CAmount newFeeFilter = 0;
-        vRecv >> newFeeFilter;
-        if (MoneyRange(newFeeFilter)) {
-            if (auto tx_relay = peer->GetTxRelay(); tx_relay != nullptr) {
-                tx_relay->m_fee_filter_received = newFeeFilter;
-            }
-            LogDebug(BCLog::NET, "received: feefilter of %s from peer=%d\n", CFeeRate(newFeeFilter).ToString(), pfrom.GetId());
-        }
-        return;
-    }
-
     if (msg_type == NetMsgType::GETCFILTERS) {
         ProcessGetCFilters(pfrom, *peer, vRecv);
         return;
@@ -5412,10 +5847,23 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
     // Don't bother if send buffer is too full to respond anyway
     if (pfrom->fPauseSend) return false;
 
-    auto poll_result{pfrom->PollMessage()};
+    LOCK(peer->m_msg_process_mutex);
+    // Transactions are queued while the peer keeps sending them, up to a batch,
+    // and validated before the peer's next other message.
+    size_t num_queued_txs{0};
+    {
+        LOCK(m_tx_download_mutex);
+        if (const auto it{m_tx_validation_queue.find(peer->m_id)}; it != m_tx_validation_queue.end()) num_queued_txs = it->second.txs.size();
+    }
+    std::optional<std::pair<CNetMessage, bool>> poll_result;
+    if (num_queued_txs == 0) {
+        poll_result = pfrom->PollMessage();
+    } else if (num_queued_txs < m_opts.tx_validation_batch) {
+        poll_result = pfrom->PollMessage([](const std::string& msg_type) { return msg_type == NetMsgType::TX; });
+    }
     if (!poll_result) {
         // No message to process
-        return false;
+        return num_queued_txs > 0 && ProcessTxValidationQueue(*pfrom, *peer);
     }
 
     CNetMessage& msg{poll_result->first};
@@ -5447,7 +5895,7 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
         //  the extra work may not be noticed, possibly resulting in an
         //  unnecessary 100ms delay)
         LOCK(m_tx_download_mutex);
-        if (m_orphanage.HaveTxToReconsider(peer->m_id)) fMoreWork = true;
+        if (m_orphanage.HaveTxToReconsider(peer->m_id) || m_tx_validation_queue.contains(peer->m_id)) fMoreWork = true;
     } catch (const std::exception& e) {
         LogDebug(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, SanitizeString(msg.m_type), msg.m_message_size, e.what(), typeid(e).name());
     } catch (...) {
@@ -5457,6 +5905,54 @@ bool PeerManagerImpl::ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt
     return fMoreWork;
 }
 
+bool PeerManagerImpl::ProcessLightMessages(CNode* pfrom)
+{
+    AssertLockNotHeld(m_tx_download_mutex);
+
+    // Captured messages are written from the message handler thread only.
+    if (m_opts.capture_messages) return false;
+
+    if (pfrom->fDisconnect || !pfrom->fSuccessfullyConnected || pfrom->fPauseSend) return false;
+
+    PeerRef peer = GetPeerRef(pfrom->GetId());
+    if (peer == nullptr) return false;
+
+    // Leave the peer to the message handler thread while it processes one of its
+    // messages, or while it still has to answer earlier getdata requests, reconsider
+    // orphans of it or validate its queued transactions, to keep the order of
+    // processing and responses.
+    TRY_LOCK(peer->m_msg_process_mutex, lock);
+    if (!lock) return false;
+    if (WITH_LOCK(peer->m_getdata_requests_mutex, return !peer->m_getdata_requests.empty())) return false;
+    if (WITH_LOCK(m_tx_download_mutex, return m_orphanage.HaveTxToReconsider(peer->m_id) || m_tx_validation_queue.contains(peer->m_id))) return false;
+
+    auto poll_result{pfrom->PollMessage(IsLightMessage)};
+    if (!poll_result) return false;
+
+    CNetMessage& msg{poll_result->first};
+
+    TRACE6(net, inbound_message,
+        pfrom->GetId(),
+        pfrom->m_addr_name.c_str(),
+        pfrom->ConnectionTypeAsString().c_str(),
+        msg.m_type.c_str(),
+        msg.m_recv.size(),
+        msg.m_recv.data()
+    );
+
+    LogDebug(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(msg.m_type), msg.m_recv.size(), pfrom->GetId());
+
+    try {
+        ProcessLightMessage(*pfrom, *peer, msg.m_type, msg.m_recv, msg.m_time);
+    } catch (const std::exception& e) {
+        LogDebug(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, SanitizeString(msg.m_type), msg.m_message_size, e.what(), typeid(e).name());
+    } catch (...) {
+        LogDebug(BCLog::NET, "%s(%s, %u bytes): Unknown exception caught\n", __func__, SanitizeString(msg.m_type), msg.m_message_size);
+    }
+
+    return poll_result->second;
+}
+
 void PeerManagerImpl::ConsiderEviction(CNode& pto, Peer& peer, std::chrono::seconds time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -5820,27 +6316,6 @@ void PeerManagerImpl::MaybeSendFeefilter(CNode& pto, Peer& peer, std::chrono::mi
     }
 }
 
-namespace {
-class CompareInvMempoolOrder
-{
-    CTxMemPool* mp;
-    bool m_wtxid_relay;
-public:
-    explicit CompareInvMempoolOrder(CTxMemPool *_mempool, bool use_wtxid)
-    {
-        mp = _mempool;
-        m_wtxid_relay = use_wtxid;
-    }
-
-    bool operator()(std::set<uint256>::iterator a, std::set<uint256>::iterator b)
-    {
-        /* As std::make_heap produces a max-heap, we want the entries with the
-         * fewest ancestors/highest fee to sort later. */
-        return mp->CompareDepthAndScore(*b, *a, m_wtxid_relay);
-    }
-};
-} // namespace
-
 bool PeerManagerImpl::RejectIncomingTxs(const CNode& peer) const
 {
     // block-relay-only peers may never send txs to us
@@ -6041,13 +6516,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                     LogDebug(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", __func__,
                             vHeaders.front().GetHash().ToString(), pto->GetId());
 
-                    std::optional<CSerializedNetMsg> cached_cmpctblock_msg;
-                    {
-                        LOCK(m_most_recent_block_mutex);
-                        if (m_most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                            cached_cmpctblock_msg = NetMsg::Make(NetMsgType::CMPCTBLOCK, *m_most_recent_compact_block);
-                        }
-                    }
+                    std::optional<CSerializedNetMsg> cached_cmpctblock_msg{GetMostRecentBlockMsg(pBestIndex->GetBlockHash(), MSG_CMPCT_BLOCK)};
                     if (cached_cmpctblock_msg.has_value()) {
                         PushMessage(*pto, std::move(cached_cmpctblock_msg.value()));
                     } else {
@@ -6135,8 +6604,8 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
 
                 // Time to send but the peer has requested we not relay transactions.
                 if (fSendTrickle) {
-                    LOCK(tx_relay->m_bloom_filter_mutex);
-                    if (!tx_relay->m_relay_txs) tx_relay->m_tx_inventory_to_send.clear();
+                    LOCK2(m_tx_announce_mutex, tx_relay->m_bloom_filter_mutex);
+                    if (!tx_relay->m_relay_txs) ClearTxAnnouncements(*tx_relay);
                 }
 
                 // Respond to BIP35 mempool requests
@@ -6145,7 +6614,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                     tx_relay->m_send_mempool = false;
                     const CFeeRate filterrate{tx_relay->m_fee_filter_received.load()};
 
-                    LOCK(tx_relay->m_bloom_filter_mutex);
+                    LOCK2(m_tx_announce_mutex, tx_relay->m_bloom_filter_mutex);
 
                     for (const auto& txinfo : vtxinfo) {
                         CInv inv{
@@ -6154,7 +6623,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                                 txinfo.tx->GetWitnessHash().ToUint256() :
                                 txinfo.tx->GetHash().ToUint256(),
                         };
-                        tx_relay->m_tx_inventory_to_send.erase(inv.hash);
+                        DequeueTxAnnouncement(*tx_relay, inv.hash);
 
                         // Don't send transactions that peers will not put into their mempool
                         if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
@@ -6163,7 +6632,7 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                         if (tx_relay->m_bloom_filter) {
                             if (!tx_relay->m_bloom_filter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                         }
-                        tx_relay->m_tx_inventory_known_filter.insert(inv.hash);
+                        m_tx_inventory_known.Add(peer->m_id, inv.hash);
                         vInv.push_back(inv);
                         if (vInv.size() == MAX_INV_SZ) {
                             MakeAndPushMessage(*pto, NetMsgType::INV, vInv);
@@ -6174,46 +6643,32 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
 
                 // Determine transactions to relay
                 if (fSendTrickle) {
-                    // Produce a vector with all candidates for sending
-                    std::vector<std::set<uint256>::iterator> vInvTx;
-                    vInvTx.reserve(tx_relay->m_tx_inventory_to_send.size());
-                    for (std::set<uint256>::iterator it = tx_relay->m_tx_inventory_to_send.begin(); it != tx_relay->m_tx_inventory_to_send.end(); it++) {
-                        vInvTx.push_back(it);
-                    }
                     const CFeeRate filterrate{tx_relay->m_fee_filter_received.load()};
-                    // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
-                    // A heap is used so that not all items need sorting if only a few are being sent.
-                    CompareInvMempoolOrder compareInvMempoolOrder(&m_mempool, peer->m_wtxid_relay);
-                    std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
                     // No reason to drain out at many times the network's capacity,
                     // especially since we have many peers and some will draw much shorter delays.
                     unsigned int nRelayedTransactions = 0;
-                    LOCK(tx_relay->m_bloom_filter_mutex);
-                    size_t broadcast_max{INVENTORY_BROADCAST_TARGET + (tx_relay->m_tx_inventory_to_send.size()/1000)*5};
+                    LOCK2(m_tx_announce_mutex, tx_relay->m_bloom_filter_mutex);
+                    auto& to_send{tx_relay->m_tx_inventory_to_send};
+                    size_t broadcast_max{INVENTORY_BROADCAST_TARGET + (to_send.size()/1000)*5};
                     broadcast_max = std::min<size_t>(INVENTORY_BROADCAST_MAX, broadcast_max);
-                    while (!vInvTx.empty() && nRelayedTransactions < broadcast_max) {
-                        // Fetch the top element from the heap
-                        std::pop_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
-                        std::set<uint256>::iterator it = vInvTx.back();
-                        vInvTx.pop_back();
-                        uint256 hash = *it;
+                    const auto consider{[&](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(tx_relay->m_tx_inventory_mutex, m_tx_announce_mutex, tx_relay->m_bloom_filter_mutex) {
                         CInv inv(peer->m_wtxid_relay ? MSG_WTX : MSG_TX, hash);
                         // Remove it from the to-be-sent set
-                        tx_relay->m_tx_inventory_to_send.erase(it);
+                        DequeueTxAnnouncement(*tx_relay, hash);
                         // Check if not in the filter already
-                        if (tx_relay->m_tx_inventory_known_filter.contains(hash)) {
-                            continue;
+                        if (m_tx_inventory_known.Contains(peer->m_id, hash)) {
+                            return;
                         }
                         // Not in the mempool anymore? don't bother sending it.
                         auto txinfo = m_mempool.info(ToGenTxid(inv));
                         if (!txinfo.tx) {
-                            continue;
+                            return;
                         }
                         // Peer told you to not send transactions at that feerate? Don't bother sending it.
                         if (txinfo.fee < filterrate.GetFee(txinfo.vsize)) {
-                            continue;
+                            return;
                         }
-                        if (tx_relay->m_bloom_filter && !tx_relay->m_bloom_filter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                        if (tx_relay->m_bloom_filter && !tx_relay->m_bloom_filter->IsRelevantAndUpdate(*txinfo.tx)) return;
                         // Send
                         vInv.push_back(inv);
                         nRelayedTransactions++;
@@ -6221,7 +6676,30 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
                             MakeAndPushMessage(*pto, NetMsgType::INV, vInv);
                             vInv.clear();
                         }
-                        tx_relay->m_tx_inventory_known_filter.insert(hash);
+                        m_tx_inventory_known.Add(peer->m_id, hash);
+                    }};
+                    // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
+                    // The order is shared by all peers, so it is only computed once per trickle.
+                    UpdateTxAnnouncementOrder();
+                    if (to_send.size() * 4 >= m_tx_announce_order.size()) {
+                        // Most queued transactions are queued for this peer, so walk the shared order.
+                        for (const uint256& hash : m_tx_announce_order) {
+                            if (to_send.empty() || nRelayedTransactions >= broadcast_max) break;
+                            if (to_send.contains(hash)) consider(hash);
+                        }
+                    } else {
+                        // Only a few are, so sort them by their position in the shared order.
+                        std::vector<std::pair<size_t, uint256>> candidates;
+                        candidates.reserve(to_send.size());
+                        for (const uint256& hash : to_send) {
+                            const auto it{m_tx_announce.find(hash)};
+                            if (Assume(it != m_tx_announce.end())) candidates.emplace_back(it->second.rank, hash);
+                        }
+                        std::sort(candidates.begin(), candidates.end());
+                        for (const auto& [_, hash] : candidates) {
+                            if (nRelayedTransactions >= broadcast_max) break;
+                            consider(hash);
+                        }
                     }
 
                     // Ensure we'll respond to GETDATA requests for anything we've just announced
@@ -6303,11 +6781,11 @@ bool PeerManagerImpl::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (CanServeBlocks(*peer) && ((sync_blocks_and_headers_from_peer && !IsLimitedPeer(*peer)) || !m_chainman.IsInitialBlockDownload()) && state.vBlocksInFlight.size() < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (CanServeBlocks(*peer) && ((sync_blocks_and_headers_from_peer && !IsLimitedPeer(*peer)) || !m_chainman.IsInitialBlockDownload()) && state.vBlocksInFlight.size() < static_cast<size_t>(GetBlocksInFlightLimit(state))) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            auto get_inflight_budget = [&state]() {
-                return std::max(0, MAX_BLOCKS_IN_TRANSIT_PER_PEER - static_cast<int>(state.vBlocksInFlight.size()));
+            auto get_inflight_budget = [&]() {
+                return std::max(0, GetBlocksInFlightLimit(state) - static_cast<int>(state.vBlocksInFlight.size()));
             };
 
             // If a snapshot chainstate is in use, we want to find its next blocks
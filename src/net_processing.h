@@ -7,6 +7,7 @@
 #define BITCOIN_NET_PROCESSING_H
 
 #include <net.h>
+#include <node/served_block_cache.h>
 #include <txorphanage.h>
 #include <validationinterface.h>
 
@@ -35,6 +36,14 @@ static const unsigned int MAX_CMPCTBLOCKS_INFLIGHT_PER_BLOCK = 3;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
+/** Default for -headerscache, serving getheaders from serialized active chain headers */
+static constexpr bool DEFAULT_HEADERS_CACHE{false};
+/** Default for -servedblockcache, in MiB */
+static constexpr unsigned int DEFAULT_SERVED_BLOCK_CACHE_SIZE{32};
+/** Default for -txvalidationbatch, 1 validates every transaction message on its own */
+static constexpr unsigned int DEFAULT_TX_VALIDATION_BATCH{1};
+/** Maximum for -txvalidationbatch */
+static constexpr unsigned int MAX_TX_VALIDATION_BATCH{100};
 
 struct CNodeStateStats {
     int nSyncHeight = -1;
@@ -55,6 +64,7 @@ struct CNodeStateStats {
 struct PeerManagerInfo {
     std::chrono::seconds median_outbound_time_offset{0s};
     bool ignores_incoming_txs{false};
+    node::ServedBlockCache::Stats served_block_cache{};
 };
 
 class PeerManager : public CValidationInterface, public NetEventsInterface
@@ -78,6 +88,14 @@ public:
         //! Number of headers sent in one getheaders message result (this is
         //! a test-only option).
         uint32_t max_headers_result{MAX_HEADERS_RESULTS};
+        //! Whether getheaders responses are served from a cache of serialized
+        //! active chain headers, at 81 bytes of memory per block
+        bool headers_cache{DEFAULT_HEADERS_CACHE};
+        //! Memory limit for caching recently served blocks, in bytes
+        size_t served_block_cache_bytes{DEFAULT_SERVED_BLOCK_CACHE_SIZE << 20};
+        //! Maximum number of consecutive transaction messages of a peer that are
+        //! queued and validated together
+        uint32_t tx_validation_batch{DEFAULT_TX_VALIDATION_BATCH};
     };
 
     static std::unique_ptr<PeerManager> make(CConnman& connman, AddrMan& addrman,
@@ -270,6 +270,7 @@ public:
     };
 
     friend class CSubNet;
+    friend class SubNetTrie;
 
 private:
     /**
@@ -486,6 +487,8 @@ protected:
     /// Is this value valid? (only used to signal parse errors)
     bool valid;
 
+    friend class SubNetTrie;
+
 public:
     /**
      * Construct an invalid subnet (empty, `Match()` always returns false).
@@ -0,0 +1,249 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/block_template_cache.h>
+
+#include <chain.h>
+#include <consensus/consensus.h>
+#include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <logging.h>
+#include <policy/policy.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <txmempool.h>
+#include <util/check.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace node {
+BlockTemplateCache::BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool, const BlockAssembler::Options& options)
+    : m_chainman{chainman},
+      m_mempool{mempool},
+      m_options{options},
+      m_max_weight{std::clamp<uint64_t>(options.nBlockMaxWeight, options.coinbase_max_additional_weight, DEFAULT_BLOCK_MAX_WEIGHT)}
+{
+}
+
+bool BlockTemplateCache::Covers(const BlockCreateOptions& options) const
+{
+    return options.use_mempool &&
+           options.coinbase_max_additional_weight == m_options.coinbase_max_additional_weight &&
+           options.coinbase_output_max_additional_sigops == m_options.coinbase_output_max_additional_sigops;
+}
+
+std::unique_ptr<CBlockTemplate> BlockTemplateCache::Get(const CScript& script_pub_key)
+{
+    const CBlockIndex* tip{WITH_LOCK(::cs_main, return m_chainman.ActiveChain().Tip())};
+    {
+        LOCK(m_mutex);
+        if (m_template && m_tip == tip) return MakeTemplate(script_pub_key);
+    }
+    // The tip changed before the callback did, or there is no template yet.
+    LOCK2(::cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    if (!m_template || m_tip != m_chainman.ActiveChain().Tip()) Rebuild();
+    return MakeTemplate(script_pub_key);
+}
+
+BlockTemplateCache::Stats BlockTemplateCache::GetStats() const
+{
+    LOCK(m_mutex);
+    return m_stats;
+}
+
+void BlockTemplateCache::Rebuild()
+{
+    AssertLockHeld(::cs_main);
+    AssertLockHeld(m_mempool.cs);
+    AssertLockHeld(m_mutex);
+
+    Chainstate& chainstate{m_chainman.ActiveChainstate()};
+    auto block_template{BlockAssembler{chainstate, &m_mempool, m_options}.CreateNewBlock(CScript{})};
+
+    const CBlockIndex* tip{Assert(chainstate.m_chain.Tip())};
+    m_tip = tip;
+    m_height = tip->nHeight + 1;
+    m_lock_time_cutoff = tip->GetMedianTimePast();
+    m_weight = m_options.coinbase_max_additional_weight;
+    m_sigops_cost = m_options.coinbase_output_max_additional_sigops;
+    m_fees = -block_template->vTxFees[0];
+    m_min_feerate = CFeeRate{MAX_MONEY};
+    m_in_block.clear();
+    const auto& vtx{block_template->block.vtx};
+    for (size_t i{1}; i < vtx.size(); ++i) {
+        m_weight += GetTransactionWeight(*vtx[i]);
+        m_sigops_cost += block_template->vTxSigOpsCost[i];
+        m_min_feerate = std::min(m_min_feerate, CFeeRate{block_template->vTxFees[i], static_cast<uint32_t>(GetVirtualTransactionSize(*vtx[i]))});
+        m_in_block.insert(vtx[i]->GetHash());
+    }
+    m_template = std::move(block_template);
+    m_sequence = m_mempool.GetSequence();
+    m_coinbase_stale = false;
+    m_improvable = false;
+    m_last_build = SteadyClock::now();
+    ++m_stats.builds;
+}
+
+void BlockTemplateCache::MaybeRebuild()
+{
+    if (!WITH_LOCK(m_mutex, return m_template && m_improvable && SteadyClock::now() - m_last_build >= TEMPLATE_REBUILD_INTERVAL)) return;
+    LOCK2(::cs_main, m_mempool.cs);
+    LOCK(m_mutex);
+    // A template on an old tip is rebuilt when the tip update arrives.
+    if (!m_template || m_tip != m_chainman.ActiveChain().Tip()) return;
+    RebuildInBackground();
+}
+
+void BlockTemplateCache::RebuildInBackground()
+{
+    AssertLockHeld(m_mutex);
+    try {
+        Rebuild();
+    } catch (const std::exception& e) {
+        LogError("Failed to rebuild the cached block template: %s\n", e.what());
+        m_template.reset();
+    }
+}
+
+void BlockTemplateCache::Append(const CTxMemPoolEntry& entry)
+{
+    AssertLockHeld(m_mempool.cs);
+    AssertLockHeld(m_mutex);
+
+    const CTransaction& tx{entry.GetTx()};
+    if (m_in_block.contains(tx.GetHash())) return;
+    // Transactions accepted on another tip are left to the rebuild for that tip.
+    if (static_cast<int>(entry.GetHeight()) + 1 != m_height) return;
+    if (CFeeRate{entry.GetModifiedFee(), static_cast<uint32_t>(entry.GetTxSize())} < m_options.blockMinFeeRate) return;
+    for (const CTxMemPoolEntry& parent : entry.GetMemPoolParentsConst()) {
+        if (!m_in_block.contains(parent.GetTx().GetHash())) {
+            // A rebuild may select it together with its ancestors.
+            m_improvable = true;
+            return;
+        }
+    }
+    if (!IsFinalTx(tx, m_height, m_lock_time_cutoff)) return;
+
+    const CFeeRate feerate{entry.GetFee(), static_cast<uint32_t>(entry.GetTxSize())};
+    if (m_weight + entry.GetTxWeight() >= m_max_weight || m_sigops_cost + entry.GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST) {
+        if (m_min_feerate < feerate) m_improvable = true;
+        return;
+    }
+
+    m_template->block.vtx.emplace_back(entry.GetSharedTx());
+    m_template->vTxFees.push_back(entry.GetFee());
+    m_template->vTxSigOpsCost.push_back(entry.GetSigOpCost());
+    m_weight += entry.GetTxWeight();
+    m_sigops_cost += entry.GetSigOpCost();
+    m_fees += entry.GetFee();
+    m_min_feerate = std::min(m_min_feerate, feerate);
+    m_in_block.insert(tx.GetHash());
+    m_coinbase_stale = true;
+    ++m_stats.txs_appended;
+}
+
+void BlockTemplateCache::Remove(const Txid& txid)
+{
+    AssertLockHeld(m_mutex);
+
+    auto& vtx{m_template->block.vtx};
+    auto& fees{m_template->vTxFees};
+    auto& sigops{m_template->vTxSigOpsCost};
+    // Descendants follow their ancestors in the block, so one pass finds them all.
+    std::unordered_set<Txid, SaltedTxidHasher> removed{txid};
+    size_t kept{1};
+    for (size_t i{1}; i < vtx.size(); ++i) {
+        const CTransaction& tx{*vtx[i]};
+        if (removed.contains(tx.GetHash()) ||
+            std::any_of(tx.vin.begin(), tx.vin.end(), [&](const CTxIn& in) { return removed.contains(in.prevout.hash); })) {
+            removed.insert(tx.GetHash());
+            m_weight -= GetTransactionWeight(tx);
+            m_sigops_cost -= sigops[i];
+            m_fees -= fees[i];
+            m_in_block.erase(tx.GetHash());
+            ++m_stats.txs_removed;
+            continue;
+        }
+        if (kept != i) {
+            vtx[kept] = std::move(vtx[i]);
+            fees[kept] = fees[i];
+            sigops[kept] = sigops[i];
+        }
+        ++kept;
+    }
+    vtx.resize(kept);
+    fees.resize(kept);
+    sigops.resize(kept);
+    m_coinbase_stale = true;
+    m_improvable = true;
+}
+
+std::unique_ptr<CBlockTemplate> BlockTemplateCache::MakeTemplate(const CScript& script_pub_key)
+{
+    AssertLockHeld(m_mutex);
+
+    CBlock& block{m_template->block};
+    if (m_coinbase_stale) {
+        CMutableTransaction coinbase{*block.vtx[0]};
+        coinbase.vout[0].nValue = m_fees + GetBlockSubsidy(m_height, m_chainman.GetConsensus());
+        if (const int index{GetWitnessCommitmentIndex(block)}; index != NO_WITNESS_COMMITMENT) {
+            coinbase.vout.erase(coinbase.vout.begin() + index);
+        }
+        block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+        m_template->vchCoinbaseCommitment = m_chainman.GenerateCoinbaseCommitment(block, m_tip);
+        m_template->vTxFees[0] = -m_fees;
+        m_coinbase_stale = false;
+    }
+
+    auto result{std::make_unique<CBlockTemplate>(*m_template)};
+    CMutableTransaction coinbase{*result->block.vtx[0]};
+    coinbase.vout[0].scriptPubKey = script_pub_key;
+    result->block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+    result->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*result->block.vtx[0]);
+    UpdateTime(&result->block, m_chainman.GetConsensus(), m_tip);
+
+    BlockAssembler::m_last_block_num_txs = result->block.vtx.size() - 1;
+    BlockAssembler::m_last_block_weight = m_weight;
+    return result;
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence)
+{
+    {
+        LOCK2(m_mempool.cs, m_mutex);
+        if (!m_template || mempool_sequence < m_sequence) return;
+        m_sequence = mempool_sequence + 1;
+        // If the transaction left the mempool again, a later callback reports it.
+        if (const auto it{m_mempool.GetIter(tx.info.m_tx->GetHash())}) Append(**it);
+    }
+    MaybeRebuild();
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence)
+{
+    {
+        LOCK(m_mutex);
+        if (!m_template || mempool_sequence < m_sequence) return;
+        m_sequence = mempool_sequence + 1;
+        if (m_in_block.contains(tx->GetHash())) Remove(tx->GetHash());
+    }
+    MaybeRebuild();
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) return;
+    // Only keep a template up to date once it has been asked for.
+    if (WITH_LOCK(m_mutex, return !m_template)) return;
+    LOCK2(::cs_main, m_mempool.cs);
+    // If the tip moved on already, its own update follows.
+    if (pindexNew != m_chainman.ActiveChain().Tip()) return;
+    LOCK(m_mutex);
+    if (m_template && m_tip == pindexNew) return;
+    RebuildInBackground();
+}
+} // namespace node
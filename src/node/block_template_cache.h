@@ -0,0 +1,128 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_BLOCK_TEMPLATE_CACHE_H
+#define BITCOIN_NODE_BLOCK_TEMPLATE_CACHE_H
+
+#include <consensus/amount.h>
+#include <kernel/cs_main.h>
+#include <node/miner.h>
+#include <policy/feerate.h>
+#include <sync.h>
+#include <util/hasher.h>
+#include <util/time.h>
+#include <validationinterface.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+
+class CBlockIndex;
+class CScript;
+class CTxMemPool;
+class CTxMemPoolEntry;
+class ChainstateManager;
+
+namespace node {
+static const bool DEFAULT_BLOCK_TEMPLATE_CACHE{false};
+
+/** Minimum time between rebuilds of a template that mempool changes could improve. */
+static constexpr auto TEMPLATE_REBUILD_INTERVAL{5s};
+
+/**
+ * Block template that is kept up to date as the mempool changes, so that
+ * getblocktemplate and Mining::createNewBlock don't have to assemble a new
+ * block under cs_main and the mempool lock on every call.
+ *
+ * The template is built by BlockAssembler on first use, and rebuilt from the
+ * validation interface callbacks when the tip changes, so the rebuild and its
+ * TestBlockValidity run on the callback thread rather than in the caller.
+ * In between, transactions that enter the mempool are appended when their
+ * mempool parents are already in the template and they fit, and transactions
+ * that leave the mempool are removed together with their descendants in the
+ * template. Appended transactions were validated by the mempool against the
+ * same tip, so appending skips TestBlockValidity.
+ *
+ * Appending does not reorder the template. When a transaction is left out
+ * although it might improve the template (the block is full and it pays more
+ * than the lowest feerate in it, or its parents were left out), or space is
+ * freed by a removal, the template is rebuilt from the callback thread, at
+ * most once every TEMPLATE_REBUILD_INTERVAL.
+ *
+ * Callbacks are applied in mempool sequence order. Those older than the
+ * latest rebuild are already reflected in the template and are skipped. The
+ * template always matches the mempool as of some callback, so it is valid for
+ * the tip it was built on. When the tip changed before the callback did,
+ * Get() rebuilds it.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+public:
+    struct Stats {
+        uint64_t builds{0};
+        uint64_t txs_appended{0};
+        uint64_t txs_removed{0};
+    };
+
+    BlockTemplateCache(ChainstateManager& chainman, const CTxMemPool& mempool, const BlockAssembler::Options& options);
+
+    /** Whether templates created with these options can be served from the cache. */
+    bool Covers(const BlockCreateOptions& options) const;
+
+    /** Return a template with the coinbase paying to script_pub_key, building it if needed. */
+    std::unique_ptr<CBlockTemplate> Get(const CScript& script_pub_key) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+protected:
+    void TransactionAddedToMempool(const NewMempoolTransactionInfo& tx, uint64_t mempool_sequence) override LOCKS_EXCLUDED(::cs_main) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason, uint64_t mempool_sequence) override LOCKS_EXCLUDED(::cs_main) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override LOCKS_EXCLUDED(::cs_main) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    const BlockAssembler::Options m_options;
+    //! Weight limit for the block, clamped as BlockAssembler does
+    const uint64_t m_max_weight;
+
+    mutable Mutex m_mutex;
+    //! Template with an empty coinbase output script, or nullptr if not built (yet)
+    std::unique_ptr<CBlockTemplate> m_template GUARDED_BY(m_mutex);
+    const CBlockIndex* m_tip GUARDED_BY(m_mutex){nullptr};
+    int m_height GUARDED_BY(m_mutex){0};
+    int64_t m_lock_time_cutoff GUARDED_BY(m_mutex){0};
+    //! Weight and sigops cost, including the space reserved for the coinbase
+    uint64_t m_weight GUARDED_BY(m_mutex){0};
+    int64_t m_sigops_cost GUARDED_BY(m_mutex){0};
+    CAmount m_fees GUARDED_BY(m_mutex){0};
+    //! Lowest feerate of a transaction in the template when it was built or appended to
+    CFeeRate m_min_feerate GUARDED_BY(m_mutex);
+    std::unordered_set<Txid, SaltedTxidHasher> m_in_block GUARDED_BY(m_mutex);
+    //! Mempool sequence of the first callback not reflected in the template
+    uint64_t m_sequence GUARDED_BY(m_mutex){0};
+    //! Whether the coinbase value and witness commitment have to be updated for changed transactions
+    bool m_coinbase_stale GUARDED_BY(m_mutex){false};
+    //! Whether a rebuild could improve the template
+    bool m_improvable GUARDED_BY(m_mutex){false};
+    SteadyClock::time_point m_last_build GUARDED_BY(m_mutex);
+    Stats m_stats GUARDED_BY(m_mutex);
+
+    /** Assemble a new template on the active tip. Throws std::runtime_error if it is invalid. */
+    void Rebuild() EXCLUSIVE_LOCKS_REQUIRED(::cs_main, m_mempool.cs, m_mutex);
+    /** Rebuild if the template could be improved and the last rebuild is long enough ago. */
+    void MaybeRebuild() LOCKS_EXCLUDED(::cs_main) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Rebuild from a callback, dropping the template if that fails so that Get() reports the error. */
+    void RebuildInBackground() EXCLUSIVE_LOCKS_REQUIRED(::cs_main, m_mempool.cs, m_mutex);
+    /** Append a mempool transaction to the template if its parents are in it and it fits. */
+    void Append(const CTxMemPoolEntry& entry) EXCLUSIVE_LOCKS_REQUIRED(m_mempool.cs, m_mutex);
+    /** Remove a transaction and its descendants from the template. */
+    void Remove(const Txid& txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Return a copy of the template with the coinbase paying to script_pub_key. */
+    std::unique_ptr<CBlockTemplate> MakeTemplate(const CScript& script_pub_key) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+};
+} // namespace node
+
+#endif // BITCOIN_NODE_BLOCK_TEMPLATE_CACHE_H
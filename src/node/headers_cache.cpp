@@ -0,0 +1,40 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/headers_cache.h>
+
+#include <chain.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <util/check.h>
+
+namespace node {
+
+void HeadersCache::Update(const CChain& chain)
+{
+    if (m_tip == chain.Tip()) return;
+
+    // Drop entries above the fork point, if the chain was reorganized.
+    const CBlockIndex* fork{chain.FindFork(m_tip)};
+    const int keep{fork ? fork->nHeight + 1 : 0};
+    if (keep < Size()) m_data.resize(keep * ENTRY_SIZE);
+
+    const size_t needed{static_cast<size_t>(chain.Height() + 1) * ENTRY_SIZE};
+    if (m_data.capacity() < needed) m_data.reserve(needed + RESERVE_ENTRIES * ENTRY_SIZE);
+
+    VectorWriter writer{m_data, m_data.size()};
+    for (int height = Size(); height <= chain.Height(); ++height) {
+        writer << chain[height]->GetBlockHeader() << uint8_t{0};
+    }
+    m_tip = chain.Tip();
+    Assume(Size() == chain.Height() + 1);
+}
+
+Span<const unsigned char> HeadersCache::GetHeaders(int start_height, int count) const
+{
+    Assume(start_height >= 0 && count >= 0 && start_height + count <= Size());
+    return Span{m_data}.subspan(start_height * ENTRY_SIZE, count * ENTRY_SIZE);
+}
+
+} // namespace node
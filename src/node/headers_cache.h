@@ -0,0 +1,63 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_HEADERS_CACHE_H
+#define BITCOIN_NODE_HEADERS_CACHE_H
+
+#include <span.h>
+
+#include <cstddef>
+#include <vector>
+
+class CBlockIndex;
+class CChain;
+
+namespace node {
+
+/**
+ * Serialized headers of the active chain, indexed by height.
+ *
+ * Each entry is stored as it appears in a headers message: the 80-byte block
+ * header followed by a zero transaction count. A getheaders response for a
+ * range of the active chain is then a single slice of this buffer, instead of
+ * a CBlockHeader reconstructed and serialized per CBlockIndex.
+ *
+ * Update() appends blocks connected since the last call and, after a reorg,
+ * first truncates back to the fork point, so that keeping the cache in step
+ * with tip changes only costs the new entries. It is not thread-safe; the
+ * caller synchronizes access, normally together with the chain it is updated
+ * from.
+ *
+ * Memory use is ENTRY_SIZE bytes per block of the active chain, plus at most
+ * RESERVE_ENTRIES entries of spare capacity.
+ */
+class HeadersCache
+{
+public:
+    //! Size of one serialized entry
+    static constexpr size_t ENTRY_SIZE{80 + 1};
+    //! Entries by which capacity grows, so that appending a block rarely reallocates
+    static constexpr size_t RESERVE_ENTRIES{2016};
+
+    /** Bring the cache in line with chain. */
+    void Update(const CChain& chain);
+
+    /** Number of cached headers, which is the height of the last update plus one. */
+    int Size() const { return m_data.size() / ENTRY_SIZE; }
+
+    /**
+     * Return the serialized entries for heights [start_height, start_height + count),
+     * without the leading count of a headers message. The range must be cached.
+     */
+    Span<const unsigned char> GetHeaders(int start_height, int count) const;
+
+private:
+    std::vector<unsigned char> m_data;
+    //! Chain tip at the last Update(), used to find the fork point on a reorg
+    const CBlockIndex* m_tip{nullptr};
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_HEADERS_CACHE_H
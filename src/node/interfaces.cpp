@@ -29,6 +29,7 @@
 #include <net_processing.h>
 #include <netaddress.h>
 #include <netbase.h>
+#include <node/block_template_cache.h>
 #include <node/blockstorage.h>
 #include <node/coin.h>
 #include <node/context.h>
@@ -1008,6 +1009,9 @@ public:
 
     std::unique_ptr<BlockTemplate> createNewBlock(const CScript& script_pub_key, const BlockCreateOptions& options) override
     {
+        if (m_node.block_template_cache && m_node.block_template_cache->Covers(options)) {
+            return std::make_unique<BlockTemplateImpl>(m_node.block_template_cache->Get(script_pub_key), m_node);
+        }
         BlockAssembler::Options assemble_options{options};
         ApplyArgsManOptions(*Assert(m_node.args), assemble_options);
         return std::make_unique<BlockTemplateImpl>(BlockAssembler{chainman().ActiveChainstate(), context()->mempool.get(), assemble_options}.CreateNewBlock(script_pub_key), m_node);
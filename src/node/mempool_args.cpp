@@ -99,6 +99,8 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& argsman, const CChainP
 
     mempool_opts.persist_v1_dat = argsman.GetBoolArg("-persistmempoolv1", mempool_opts.persist_v1_dat);
 
+    mempool_opts.chunk_eviction = argsman.GetBoolArg("-mempoolchunkeviction", mempool_opts.chunk_eviction);
+
     ApplyArgsManOptions(argsman, mempool_opts.limits);
 
     return {};
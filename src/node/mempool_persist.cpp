@@ -4,9 +4,12 @@
 
 #include <node/mempool_persist.h>
 
+#include <chain.h>
 #include <clientversion.h>
 #include <consensus/amount.h>
+#include <hash.h>
 #include <logging.h>
+#include <policy/policy.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <serialize.h>
@@ -20,13 +23,17 @@
 #include <util/time.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <exception>
 #include <functional>
+#include <ios>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
+#include <span>
 #include <stdexcept>
 #include <utility>
 #include <vector>
@@ -37,6 +44,8 @@ namespace node {
 
 static const uint64_t MEMPOOL_DUMP_VERSION_NO_XOR_KEY{1};
 static const uint64_t MEMPOOL_DUMP_VERSION{2};
+/** Number of transactions accepted per cs_main lock while loading. */
+static constexpr size_t MEMPOOL_LOAD_BATCH_SIZE{100};
 
 bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active_chainstate, ImportMempoolOptions&& opts)
 {
@@ -56,37 +65,35 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
     const auto now{NodeClock::now()};
 
     try {
+        HashVerifier verifier{file};
         uint64_t version;
-        file >> version;
+        verifier >> version;
         std::vector<std::byte> xor_key;
         if (version == MEMPOOL_DUMP_VERSION_NO_XOR_KEY) {
             // Leave XOR-key empty
         } else if (version == MEMPOOL_DUMP_VERSION) {
-            file >> xor_key;
+            verifier >> xor_key;
         } else {
             return false;
         }
         file.SetXor(xor_key);
         uint64_t total_txns_to_load;
-        file >> total_txns_to_load;
-        uint64_t txns_tried = 0;
-        LogInfo("Loading %u mempool transactions from file...\n", total_txns_to_load);
-        int next_tenth_to_report = 0;
-        while (txns_tried < total_txns_to_load) {
-            const int percentage_done(100.0 * txns_tried / total_txns_to_load);
-            if (next_tenth_to_report < percentage_done / 10) {
-                LogInfo("Progress loading mempool transactions from file: %d%% (tried %u, %u remaining)\n",
-                        percentage_done, txns_tried, total_txns_to_load - txns_tried);
-                next_tenth_to_report = percentage_done / 10;
-            }
-            ++txns_tried;
+        verifier >> total_txns_to_load;
+        uint64_t txns_read = 0;
+        LogInfo("Reading %u mempool transactions from file...\n", total_txns_to_load);
+        // Transactions are dumped in topological order, so they can be accepted in batches
+        // in the order they are read.
+        std::vector<CTransactionRef> txns;
+        std::vector<int64_t> accept_times;
+        while (txns_read < total_txns_to_load) {
+            ++txns_read;
 
             CTransactionRef tx;
             int64_t nTime;
             int64_t nFeeDelta;
-            file >> TX_WITH_WITNESS(tx);
-            file >> nTime;
-            file >> nFeeDelta;
+            verifier >> TX_WITH_WITNESS(tx);
+            verifier >> nTime;
+            verifier >> nFeeDelta;
 
             if (opts.use_current_time) {
                 nTime = TicksSinceEpoch<std::chrono::seconds>(now);
@@ -97,29 +104,76 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             if (nTime > TicksSinceEpoch<std::chrono::seconds>(now - pool.m_opts.expiry)) {
-                LOCK(cs_main);
-                const auto& accepted = AcceptToMemoryPool(active_chainstate, tx, nTime, /*bypass_limits=*/false, /*test_accept=*/false);
-                if (accepted.m_result_type == MempoolAcceptResult::ResultType::VALID) {
+                txns.push_back(std::move(tx));
+                accept_times.push_back(nTime);
+            } else {
+                ++expired;
+            }
+            if (active_chainstate.m_chainman.m_interrupt)
+                return false;
+        }
+        std::map<uint256, CAmount> mapDeltas;
+        verifier >> mapDeltas;
+
+        std::set<uint256> unbroadcast_txids;
+        verifier >> unbroadcast_txids;
+
+        // Dumps written by older versions end here.
+        std::optional<uint256> dump_tip;
+        if (opts.skip_script_checks_on_same_tip) {
+            try {
+                uint256 tip_hash;
+                uint32_t script_flags;
+                verifier >> tip_hash >> script_flags;
+                const uint256 checksum{verifier.GetHash()};
+                uint256 expected_checksum;
+                file >> expected_checksum;
+                if (checksum != expected_checksum) {
+                    LogInfo("Mempool file checksum mismatch, checking all scripts.\n");
+                } else if (script_flags == STANDARD_SCRIPT_VERIFY_FLAGS) {
+                    dump_tip = tip_hash;
+                }
+            } catch (const std::ios_base::failure&) {
+                LogInfo("Mempool file has no checksum, checking all scripts.\n");
+            }
+        }
+
+        LogInfo("Loading %u mempool transactions...\n", txns.size());
+        int next_tenth_to_report = 0;
+        for (size_t begin{0}; begin < txns.size(); begin += MEMPOOL_LOAD_BATCH_SIZE) {
+            const int percentage_done(100.0 * begin / txns.size());
+            if (next_tenth_to_report < percentage_done / 10) {
+                LogInfo("Progress loading mempool transactions: %d%% (tried %u, %u remaining)\n",
+                        percentage_done, begin, txns.size() - begin);
+                next_tenth_to_report = percentage_done / 10;
+            }
+            const size_t batch_size{std::min(MEMPOOL_LOAD_BATCH_SIZE, txns.size() - begin)};
+            const auto batch{std::span{txns}.subspan(begin, batch_size)};
+
+            LOCK(cs_main);
+            // The transactions were validated on the dumped tip, so their scripts were checked
+            // with the same flags and spend the same coins, unless the tip moved since.
+            const CBlockIndex* tip{active_chainstate.m_chain.Tip()};
+            const bool skip_script_checks{dump_tip && tip && tip->GetBlockHash() == *dump_tip};
+            const auto results{AcceptBatchToMemoryPool(active_chainstate, batch, std::span{accept_times}.subspan(begin, batch_size), skip_script_checks)};
+            for (size_t i{0}; i < batch.size(); ++i) {
+                if (results[i].m_result_type == MempoolAcceptResult::ResultType::VALID) {
                     ++count;
                 } else {
                     // mempool may contain the transaction already, e.g. from
                     // wallet(s) having loaded it while we were processing
                     // mempool transactions; consider these as valid, instead of
                     // failed, but mark them as 'already there'
-                    if (pool.exists(GenTxid::Txid(tx->GetHash()))) {
+                    if (pool.exists(GenTxid::Txid(batch[i]->GetHash()))) {
                         ++already_there;
                     } else {
-                        ++failed;
+                        ++failed; LogInfo("XXX %s\n", results[i].m_state.ToString());
                     }
                 }
-            } else {
-                ++expired;
             }
             if (active_chainstate.m_chainman.m_interrupt)
                 return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
 
         if (opts.apply_fee_delta_priority) {
             for (const auto& i : mapDeltas) {
@@ -127,8 +181,6 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
             }
         }
 
-        std::set<uint256> unbroadcast_txids;
-        file >> unbroadcast_txids;
         if (opts.apply_unbroadcast_set) {
             unbroadcast = unbroadcast_txids.size();
             for (const auto& txid : unbroadcast_txids) {
@@ -146,24 +198,27 @@ bool LoadMempool(CTxMemPool& pool, const fs::path& load_path, Chainstate& active
     return true;
 }
 
-bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, FopenFn mockable_fopen_function, bool skip_file_commit)
+bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, const Chainstate& active_chainstate, FopenFn mockable_fopen_function, bool skip_file_commit)
 {
     auto start = SteadyClock::now();
 
     std::map<uint256, CAmount> mapDeltas;
     std::vector<TxMempoolInfo> vinfo;
     std::set<uint256> unbroadcast_txids;
+    uint256 tip_hash;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
     {
-        LOCK(pool.cs);
+        // The mempool is consistent with the tip while both are locked.
+        LOCK2(cs_main, pool.cs);
         for (const auto &i : pool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
         vinfo = pool.infoAll();
         unbroadcast_txids = pool.GetUnbroadcastTxs();
+        if (const CBlockIndex* tip{active_chainstate.m_chain.Tip()}) tip_hash = tip->GetBlockHash();
     }
 
     auto mid = SteadyClock::now();
@@ -174,30 +229,36 @@ bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, FopenFn mock
     }
 
     try {
+        HashedSourceWriter hashwriter{file};
         const uint64_t version{pool.m_opts.persist_v1_dat ? MEMPOOL_DUMP_VERSION_NO_XOR_KEY : MEMPOOL_DUMP_VERSION};
-        file << version;
+        hashwriter << version;
 
         std::vector<std::byte> xor_key(8);
         if (!pool.m_opts.persist_v1_dat) {
             FastRandomContext{}.fillrand(xor_key);
-            file << xor_key;
+            hashwriter << xor_key;
         }
         file.SetXor(xor_key);
 
         uint64_t mempool_transactions_to_write(vinfo.size());
-        file << mempool_transactions_to_write;
+        hashwriter << mempool_transactions_to_write;
         LogInfo("Writing %u mempool transactions to file...\n", mempool_transactions_to_write);
         for (const auto& i : vinfo) {
-            file << TX_WITH_WITNESS(*(i.tx));
-            file << int64_t{count_seconds(i.m_time)};
-            file << int64_t{i.nFeeDelta};
+            hashwriter << TX_WITH_WITNESS(*(i.tx));
+            hashwriter << int64_t{count_seconds(i.m_time)};
+            hashwriter << int64_t{i.nFeeDelta};
             mapDeltas.erase(i.tx->GetHash());
         }
 
-        file << mapDeltas;
+        hashwriter << mapDeltas;
 
         LogInfo("Writing %d unbroadcast transactions to file.\n", unbroadcast_txids.size());
-        file << unbroadcast_txids;
+        hashwriter << unbroadcast_txids;
+
+        // Older versions stop reading before the tip, the script verification flags the
+        // transactions were checked with, and the checksum.
+        hashwriter << tip_hash << uint32_t{STANDARD_SCRIPT_VERIFY_FLAGS};
+        file << hashwriter.GetHash();
 
         if (!skip_file_commit && !file.Commit())
             throw std::runtime_error("Commit failed");
@@ -12,8 +12,8 @@ class CTxMemPool;
 
 namespace node {
 
-/** Dump the mempool to a file. */
-bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path,
+/** Dump the mempool to a file, together with the tip it is valid on and a checksum. */
+bool DumpMempool(const CTxMemPool& pool, const fs::path& dump_path, const Chainstate& active_chainstate,
                  fsbridge::FopenFn mockable_fopen_function = fsbridge::fopen,
                  bool skip_file_commit = false);
 
@@ -22,6 +22,8 @@ struct ImportMempoolOptions {
     bool use_current_time{false};
     bool apply_fee_delta_priority{true};
     bool apply_unbroadcast_set{true};
+    //! Don't check scripts while the tip is the one the file was dumped on, if its checksum is valid
+    bool skip_script_checks_on_same_tip{false};
 };
 /** Import the file and attempt to add its contents to the mempool. */
 bool LoadMempool(CTxMemPool& pool, const fs::path& load_path,
@@ -16,6 +16,11 @@ namespace node {
  * automatically load the mempool on start and save to disk on shutdown
  */
 static constexpr bool DEFAULT_PERSIST_MEMPOOL{true};
+/**
+ * Default for -persistmempooltrusted, indicating whether the scripts of the
+ * loaded mempool are trusted when the tip did not change since it was saved
+ */
+static constexpr bool DEFAULT_PERSIST_MEMPOOL_TRUSTED{false};
 
 bool ShouldPersistMempool(const ArgsManager& argsman);
 fs::path MempoolPath(const ArgsManager& argsman);
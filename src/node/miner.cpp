@@ -20,11 +20,14 @@
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/transaction.h>
+#include <random.h>
+#include <util/feefrac.h>
 #include <util/moneystr.h>
 #include <util/time.h>
 #include <validation.h>
 
 #include <algorithm>
+#include <unordered_set>
 #include <utility>
 
 namespace node {
@@ -91,6 +94,7 @@ void ApplyArgsManOptions(const ArgsManager& args, BlockAssembler::Options& optio
         if (const auto parsed{ParseMoney(*blockmintxfee)}) options.blockMinFeeRate = CFeeRate{*parsed};
     }
     options.print_modified_fee = args.GetBoolArg("-printpriority", options.print_modified_fee);
+    options.cluster_linearization = args.GetBoolArg("-blockclusterlinearization", options.cluster_linearization);
 }
 
 void BlockAssembler::resetBlock()
@@ -139,7 +143,11 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     int nDescendantsUpdated = 0;
     if (m_mempool) {
         LOCK(m_mempool->cs);
-        addPackageTxs(*m_mempool, nPackagesSelected, nDescendantsUpdated);
+        if (m_options.cluster_linearization) {
+            addClusterTxs(*m_mempool, nPackagesSelected);
+        } else {
+            addPackageTxs(*m_mempool, nPackagesSelected, nDescendantsUpdated);
+        }
     }
 
     const auto time_1{SteadyClock::now()};
@@ -426,4 +434,98 @@ void BlockAssembler::addPackageTxs(const CTxMemPool& mempool, int& nPackagesSele
         nDescendantsUpdated += UpdatePackagesForAdded(mempool, ancestors, mapModifiedTx);
     }
 }
+
+// This transaction selection algorithm does not track ancestor feerates of
+// individual transactions. Instead, the mempool is split into clusters of
+// transactions connected by spends, and each cluster is linearized: put in a
+// topologically valid order whose prefixes have the highest feerates. Cutting
+// a linearization into chunks of decreasing feerate gives the groups of
+// transactions that are worth including together, also when a package has
+// several children or the best set isn't an ancestor set. The chunks of a
+// cluster already have decreasing feerates, so selecting chunks of all clusters
+// by feerate keeps each cluster in order.
+void BlockAssembler::addClusterTxs(const CTxMemPool& mempool, int& nPackagesSelected)
+{
+    AssertLockHeld(mempool.cs);
+
+    FastRandomContext rng;
+    std::vector<std::vector<CTxMemPool::txiter>> clusters;
+    std::unordered_set<const CTxMemPoolEntry*> seen;
+    seen.reserve(mempool.mapTx.size());
+    for (auto it{mempool.mapTx.begin()}; it != mempool.mapTx.end(); ++it) {
+        if (!seen.insert(&*it).second) continue;
+        auto& cluster{clusters.emplace_back(1, it)};
+        const auto visit{[&](const CTxMemPoolEntry& relative) {
+            if (seen.insert(&relative).second) cluster.push_back(mempool.mapTx.iterator_to(relative));
+        }};
+        for (size_t i{0}; i < cluster.size(); ++i) {
+            const CTxMemPoolEntry& entry{*cluster[i]};
+            for (const CTxMemPoolEntry& parent : entry.GetMemPoolParentsConst()) visit(parent);
+            for (const CTxMemPoolEntry& child : entry.GetMemPoolChildrenConst()) visit(child);
+        }
+        LinearizeCluster(cluster, rng);
+    }
+
+    struct Chunk {
+        FeeFrac feerate;
+        int64_t sigops;
+        uint32_t cluster;
+        //! Range of the chunk's transactions in the cluster's linearization
+        uint32_t begin, end;
+    };
+    std::vector<Chunk> chunks;
+    for (uint32_t c{0}; c < clusters.size(); ++c) {
+        const size_t first{chunks.size()};
+        for (uint32_t i{0}; i < clusters[c].size(); ++i) {
+            const CTxMemPool::txiter& it{clusters[c][i]};
+            Chunk chunk{{it->GetModifiedFee(), static_cast<int32_t>(it->GetTxSize())}, it->GetSigOpCost(), c, i, i + 1};
+            // Absorb the preceding chunks of the cluster that have a lower feerate.
+            while (chunks.size() > first && chunk.feerate >> chunks.back().feerate) {
+                chunk.feerate += chunks.back().feerate;
+                chunk.sigops += chunks.back().sigops;
+                chunk.begin = chunks.back().begin;
+                chunks.pop_back();
+            }
+            chunks.push_back(chunk);
+        }
+    }
+    std::stable_sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) { return a.feerate >> b.feerate; });
+
+    // Limit the number of attempts to add transactions to the block when it is
+    // close to full, as in addPackageTxs().
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+    // Clusters of which a chunk was left out; their later chunks may depend on it.
+    std::vector<bool> skipped(clusters.size(), false);
+
+    for (const Chunk& chunk : chunks) {
+        if (chunk.feerate.fee < m_options.blockMinFeeRate.GetFee(chunk.feerate.size)) {
+            // Everything else we might consider has a lower fee rate
+            return;
+        }
+        if (skipped[chunk.cluster]) continue;
+
+        const auto txs{Span{clusters[chunk.cluster]}.subspan(chunk.begin, chunk.end - chunk.begin)};
+        if (!TestPackage(chunk.feerate.size, chunk.sigops)) {
+            skipped[chunk.cluster] = true;
+            ++nConsecutiveFailed;
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockWeight >
+                    m_options.nBlockMaxWeight - m_options.coinbase_max_additional_weight) {
+                // Give up if we're close to full and haven't succeeded in a while
+                break;
+            }
+            continue;
+        }
+        if (!std::all_of(txs.begin(), txs.end(), [&](const auto& it) { return IsFinalTx(it->GetTx(), nHeight, m_lock_time_cutoff); })) {
+            skipped[chunk.cluster] = true;
+            continue;
+        }
+
+        nConsecutiveFailed = 0;
+        for (const CTxMemPool::txiter& it : txs) {
+            AddToBlock(it);
+        }
+        ++nPackagesSelected;
+    }
+}
 } // namespace node
@@ -32,6 +32,7 @@ namespace Consensus { struct Params; };
 
 namespace node {
 static const bool DEFAULT_PRINT_MODIFIED_FEE = false;
+static const bool DEFAULT_BLOCK_CLUSTER_LINEARIZATION = false;
 
 struct CBlockTemplate
 {
@@ -165,6 +166,8 @@ public:
         // Whether to call TestBlockValidity() at the end of CreateNewBlock().
         bool test_block_validity{true};
         bool print_modified_fee{DEFAULT_PRINT_MODIFIED_FEE};
+        // Whether to select transactions with addClusterTxs() instead of addPackageTxs().
+        bool cluster_linearization{DEFAULT_BLOCK_CLUSTER_LINEARIZATION};
     };
 
     explicit BlockAssembler(Chainstate& chainstate, const CTxMemPool* mempool, const Options& options);
@@ -189,6 +192,10 @@ private:
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics). */
     void addPackageTxs(const CTxMemPool& mempool, int& nPackagesSelected, int& nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /** Add transactions by chunk feerate: the mempool is split into clusters of connected
+      * transactions, each cluster is linearized, and the chunks of all clusters are
+      * merged by feerate. Increments nPackagesSelected with the number of chunks added. */
+    void addClusterTxs(const CTxMemPool& mempool, int& nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -209,7 +216,7 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
 void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
 
-/** Apply -blockmintxfee and -blockmaxweight options from ArgsManager to BlockAssembler options. */
+/** Apply -blockmintxfee, -blockmaxweight and -blockclusterlinearization options from ArgsManager to BlockAssembler options. */
 void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& options);
 } // namespace node
 
@@ -23,6 +23,16 @@ void ApplyArgsManOptions(const ArgsManager& argsman, PeerManager::Options& optio
     if (auto value{argsman.GetBoolArg("-capturemessages")}) options.capture_messages = *value;
 
     if (auto value{argsman.GetBoolArg("-blocksonly")}) options.ignore_incoming_txs = *value;
+
+    if (auto value{argsman.GetBoolArg("-headerscache")}) options.headers_cache = *value;
+
+    if (auto value{argsman.GetIntArg("-servedblockcache")}) {
+        options.served_block_cache_bytes = size_t(std::clamp<int64_t>(*value, 0, std::numeric_limits<size_t>::max() >> 20)) << 20;
+    }
+
+    if (auto value{argsman.GetIntArg("-txvalidationbatch")}) {
+        options.tx_validation_batch = uint32_t(std::clamp<int64_t>(*value, 1, MAX_TX_VALIDATION_BATCH));
+    }
 }
 
 } // namespace node
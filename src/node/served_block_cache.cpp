@@ -0,0 +1,56 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/served_block_cache.h>
+
+namespace node {
+
+ServedBlockCache::Data ServedBlockCache::Get(const uint256& hash, bool witness)
+{
+    if (m_max_bytes == 0) return nullptr;
+
+    LOCK(m_mutex);
+    const auto it{m_index.find({hash, witness})};
+    if (it == m_index.end()) {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->data;
+}
+
+void ServedBlockCache::Insert(const uint256& hash, bool witness, Data data)
+{
+    if (!data || data->size() > m_max_bytes) return;
+
+    LOCK(m_mutex);
+    const Key key{hash, witness};
+    if (m_index.contains(key)) return;
+
+    m_bytes += data->size();
+    m_lru.push_front({key, std::move(data)});
+    m_index.emplace(key, m_lru.begin());
+
+    while (m_bytes > m_max_bytes) {
+        const Entry& oldest{m_lru.back()};
+        m_bytes -= oldest.data->size();
+        m_index.erase(oldest.key);
+        m_lru.pop_back();
+    }
+}
+
+ServedBlockCache::Stats ServedBlockCache::GetStats() const
+{
+    LOCK(m_mutex);
+    return {
+        .entries = m_lru.size(),
+        .bytes = m_bytes,
+        .max_bytes = m_max_bytes,
+        .hits = m_hits,
+        .misses = m_misses,
+    };
+}
+
+} // namespace node
@@ -0,0 +1,74 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_SERVED_BLOCK_CACHE_H
+#define BITCOIN_NODE_SERVED_BLOCK_CACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace node {
+
+/**
+ * Memory-bounded LRU cache of blocks recently served to peers, in network
+ * serialization. Blocks are cached separately with and without witness data,
+ * as requested by MSG_WITNESS_BLOCK and MSG_BLOCK respectively.
+ *
+ * When many peers request the same range of recent blocks, this avoids
+ * reading each block from disk (and stripping witnesses) once per request.
+ */
+class ServedBlockCache
+{
+public:
+    using Data = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct Stats {
+        size_t entries{0};
+        size_t bytes{0};
+        size_t max_bytes{0};
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    explicit ServedBlockCache(size_t max_bytes) : m_max_bytes{max_bytes} {}
+
+    /**
+     * Return the cached serialization of a block and mark it as most recently used, or nullptr.
+     * Lookups in a disabled cache (max_bytes of 0) are not counted as misses.
+     */
+    Data Get(const uint256& hash, bool witness) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Add a serialized block, evicting least recently used ones to stay within the memory limit. */
+    void Insert(const uint256& hash, bool witness, Data data) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    Stats GetStats() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    using Key = std::pair<uint256, bool>;
+    struct Entry {
+        Key key;
+        Data data;
+    };
+
+    mutable Mutex m_mutex;
+    const size_t m_max_bytes;
+    //! Entries in order of use, most recently used first
+    std::list<Entry> m_lru GUARDED_BY(m_mutex);
+    std::map<Key, std::list<Entry>::iterator> m_index GUARDED_BY(m_mutex);
+    size_t m_bytes GUARDED_BY(m_mutex){0};
+    uint64_t m_hits GUARDED_BY(m_mutex){0};
+    uint64_t m_misses GUARDED_BY(m_mutex){0};
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_SERVED_BLOCK_CACHE_H
@@ -0,0 +1,124 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txinventory.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+#include <util/check.h>
+
+#include <algorithm>
+
+namespace node {
+
+TxInventoryKnown::TxInventoryKnown(size_t generation_size)
+    : m_k0{FastRandomContext().rand64()},
+      m_k1{FastRandomContext().rand64()},
+      m_generation_size{generation_size}
+{
+    LOCK(m_mutex);
+    m_current.index.reserve(m_generation_size);
+}
+
+uint64_t TxInventoryKnown::Key(const uint256& hash) const
+{
+    return SipHashUint256(m_k0, m_k1, hash);
+}
+
+bool TxInventoryKnown::HasBit(const Generation& gen, uint64_t key, size_t slot) const
+{
+    const auto it{gen.index.find(key)};
+    if (it == gen.index.end()) return false;
+    return (gen.bits[it->second * m_stride + slot / 64] >> (slot % 64)) & 1;
+}
+
+void TxInventoryKnown::SetStride(size_t stride)
+{
+    for (Generation* gen : {&m_current, &m_previous}) {
+        std::vector<uint64_t> bits(gen->index.size() * stride);
+        for (size_t i{0}; i < gen->index.size(); ++i) {
+            std::copy_n(gen->bits.begin() + i * m_stride, m_stride, bits.begin() + i * stride);
+        }
+        gen->bits = std::move(bits);
+    }
+    m_stride = stride;
+}
+
+void TxInventoryKnown::Rotate()
+{
+    m_previous = std::move(m_current);
+    m_current = Generation{};
+    m_current.index.reserve(m_generation_size);
+    for (auto& [_, state] : m_peers) state.added = 0;
+}
+
+void TxInventoryKnown::Add(NodeId peer, const uint256& hash)
+{
+    LOCK(m_mutex);
+    auto peer_it{m_peers.find(peer)};
+    if (peer_it == m_peers.end()) {
+        size_t slot;
+        if (!m_free_slots.empty()) {
+            slot = m_free_slots.back();
+            m_free_slots.pop_back();
+        } else {
+            slot = m_num_slots++;
+            if (slot >= m_stride * 64) SetStride(m_stride * 2);
+        }
+        peer_it = m_peers.emplace(peer, PeerState{.slot = slot}).first;
+    }
+    PeerState& state{peer_it->second};
+
+    const uint64_t key{Key(hash)};
+    auto it{m_current.index.find(key)};
+    if (it == m_current.index.end()) {
+        if (m_current.index.size() >= m_generation_size) Rotate();
+        if (state.added >= m_generation_size / 2) return;
+        ++state.added;
+        it = m_current.index.emplace(key, m_current.index.size()).first;
+        m_current.bits.resize(m_current.bits.size() + m_stride);
+        // Keep what other peers know about a hash from the previous generation.
+        if (const auto prev{m_previous.index.find(key)}; prev != m_previous.index.end()) {
+            std::copy_n(m_previous.bits.begin() + prev->second * m_stride, m_stride, m_current.bits.end() - m_stride);
+        }
+    }
+    m_current.bits[it->second * m_stride + state.slot / 64] |= uint64_t{1} << (state.slot % 64);
+}
+
+bool TxInventoryKnown::Contains(NodeId peer, const uint256& hash) const
+{
+    LOCK(m_mutex);
+    const auto peer_it{m_peers.find(peer)};
+    if (peer_it == m_peers.end()) return false;
+    const uint64_t key{Key(hash)};
+    const size_t slot{peer_it->second.slot};
+    return HasBit(m_current, key, slot) || HasBit(m_previous, key, slot);
+}
+
+void TxInventoryKnown::ForgetPeer(NodeId peer)
+{
+    LOCK(m_mutex);
+    const auto peer_it{m_peers.find(peer)};
+    if (peer_it == m_peers.end()) return;
+    const size_t slot{peer_it->second.slot};
+    const uint64_t mask{~(uint64_t{1} << (slot % 64))};
+    for (Generation* gen : {&m_current, &m_previous}) {
+        for (size_t i{slot / 64}; i < gen->bits.size(); i += m_stride) {
+            gen->bits[i] &= mask;
+        }
+    }
+    m_free_slots.push_back(slot);
+    m_peers.erase(peer_it);
+}
+
+size_t TxInventoryKnown::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return memusage::DynamicUsage(m_current.index) + memusage::DynamicUsage(m_current.bits) +
+           memusage::DynamicUsage(m_previous.index) + memusage::DynamicUsage(m_previous.bits) +
+           memusage::DynamicUsage(m_peers) + memusage::DynamicUsage(m_free_slots);
+}
+
+} // namespace node
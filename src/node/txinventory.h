@@ -0,0 +1,92 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_TXINVENTORY_H
+#define BITCOIN_NODE_TXINVENTORY_H
+
+#include <net.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace node {
+
+/** Number of (w)txids per generation of the TxInventoryKnown table. */
+static constexpr size_t DEFAULT_TX_INVENTORY_GENERATION_SIZE{50000};
+
+/**
+ * Record of which transactions each peer is known to have, because it announced
+ * them to us or we announced them to it.
+ *
+ * Instead of a rolling bloom filter per peer (about 1 MB each), all peers share one
+ * table of recently seen (w)txids, with one bit per peer in each entry. Most
+ * transactions are known to most peers, so a table entry costs little more than a
+ * bloom filter entry for a single peer.
+ *
+ * The table remembers the hashes touched in the current and the previous generation.
+ * A generation ends after `generation_size` new entries, so between `generation_size`
+ * and twice that many hashes are remembered. Hashes are keyed by a salted 64-bit
+ * hash, so false positives are practically impossible. To stop a single peer from
+ * flushing the table by announcing made up hashes, each peer can add at most half of
+ * the entries of a generation. Forgetting a hash only leads to a redundant
+ * announcement, like a bloom filter that has rolled over.
+ */
+class TxInventoryKnown
+{
+public:
+    explicit TxInventoryKnown(size_t generation_size = DEFAULT_TX_INVENTORY_GENERATION_SIZE);
+
+    /** Record that a peer knows a (w)txid. */
+    void Add(NodeId peer, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Whether a peer is known to have a (w)txid. */
+    bool Contains(NodeId peer, const uint256& hash) const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Forget everything about a peer. Its bit is cleared in all entries so it can be reused. */
+    void ForgetPeer(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Heap memory used by the table. */
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    //! Entries added during one generation; the bits of entry i are m_bits[i * m_stride, (i + 1) * m_stride).
+    struct Generation {
+        std::unordered_map<uint64_t, uint32_t> index;
+        std::vector<uint64_t> bits;
+    };
+
+    struct PeerState {
+        //! Position of the peer's bit in each entry
+        size_t slot;
+        //! Number of entries the peer added in the current generation
+        size_t added{0};
+    };
+
+    mutable Mutex m_mutex;
+    const uint64_t m_k0, m_k1;
+    const size_t m_generation_size;
+    //! Number of 64-bit words per entry
+    size_t m_stride GUARDED_BY(m_mutex){1};
+    Generation m_current GUARDED_BY(m_mutex);
+    Generation m_previous GUARDED_BY(m_mutex);
+    std::unordered_map<NodeId, PeerState> m_peers GUARDED_BY(m_mutex);
+    //! Slots of forgotten peers, available for reuse
+    std::vector<size_t> m_free_slots GUARDED_BY(m_mutex);
+    size_t m_num_slots GUARDED_BY(m_mutex){0};
+
+    uint64_t Key(const uint256& hash) const;
+    bool HasBit(const Generation& gen, uint64_t key, size_t slot) const EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Give every entry `stride` words, to make room for more slots. */
+    void SetStride(size_t stride) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+    /** Start a new generation, dropping the entries of the previous one. */
+    void Rotate() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_TXINVENTORY_H
@@ -35,6 +35,7 @@ public:
     }
 
     SERIALIZE_METHODS(CBlockHeader, obj) { READWRITE(obj.nVersion, obj.hashPrevBlock, obj.hashMerkleRoot, obj.nTime, obj.nBits, obj.nNonce); }
+    using TriviallySerializableType = CBlockHeader;
 
     void SetNull()
     {
@@ -0,0 +1,137 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <primitives/block_view.h>
+
+#include <serialize.h>
+
+#include <algorithm>
+#include <ios>
+#include <utility>
+
+namespace {
+
+/** Bounds-checked cursor over a serialized block, usable as a deserialization stream. */
+class ViewReader
+{
+    const Span<const std::byte> m_data;
+    size_t m_pos{0};
+
+public:
+    explicit ViewReader(Span<const std::byte> data) : m_data{data} {}
+
+    size_t Pos() const { return m_pos; }
+    bool empty() const { return m_pos == m_data.size(); }
+
+    /** Return the next n bytes and advance past them. */
+    Span<const std::byte> Take(size_t n)
+    {
+        if (n > m_data.size() - m_pos) {
+            throw std::ios_base::failure("BlockView: end of data");
+        }
+        const auto ret{m_data.subspan(m_pos, n)};
+        m_pos += n;
+        return ret;
+    }
+
+    Span<const std::byte> Slice(size_t begin, size_t end) const { return m_data.subspan(begin, end - begin); }
+
+    void read(Span<std::byte> dst)
+    {
+        const auto src{Take(dst.size())};
+        std::copy(src.begin(), src.end(), dst.begin());
+    }
+
+    template <typename T>
+    ViewReader& operator>>(T&& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+};
+
+/** Skip a transaction input. */
+void SkipInput(ViewReader& reader)
+{
+    reader.Take(32 + 4);
+    reader.Take(ReadCompactSize(reader));
+    reader.Take(4);
+}
+
+/** Skip a transaction output. */
+void SkipOutput(ViewReader& reader)
+{
+    reader.Take(8);
+    reader.Take(ReadCompactSize(reader));
+}
+
+/** Skip a witness stack, returning whether it has any items. */
+bool SkipWitness(ViewReader& reader)
+{
+    const uint64_t num_items{ReadCompactSize(reader)};
+    for (uint64_t i = 0; i < num_items; ++i) {
+        reader.Take(ReadCompactSize(reader));
+    }
+    return num_items != 0;
+}
+
+} // namespace
+
+BlockView::BlockView(std::vector<uint8_t>&& data) : m_data{std::move(data)}
+{
+    ViewReader reader{MakeByteSpan(m_data)};
+    reader.Take(HEADER_SIZE);
+
+    const uint64_t num_txs{ReadCompactSize(reader)};
+    // A transaction is at least 10 bytes, which bounds the reservation for bogus counts.
+    m_txs.reserve(std::min<uint64_t>(num_txs, m_data.size() / 10));
+    for (uint64_t t = 0; t < num_txs; ++t) {
+        const size_t tx_begin{reader.Pos()};
+        TxView& tx{m_txs.emplace_back()};
+
+        reader >> tx.m_version;
+        size_t base_begin{reader.Pos()};
+        uint8_t flags{0};
+        uint64_t num_in{ReadCompactSize(reader)};
+        if (num_in == 0) {
+            // Either a witness marker or an empty vin, as in UnserializeTransaction().
+            reader >> flags;
+            if (flags != 0) {
+                base_begin = reader.Pos();
+                num_in = ReadCompactSize(reader);
+            }
+        }
+        if (num_in != 0 || flags != 0) {
+            for (uint64_t i = 0; i < num_in; ++i) {
+                SkipInput(reader);
+            }
+            const uint64_t num_out{ReadCompactSize(reader)};
+            for (uint64_t i = 0; i < num_out; ++i) {
+                SkipOutput(reader);
+            }
+        }
+        const size_t base_end{reader.Pos()};
+
+        tx.m_has_witness = false;
+        if (flags & 1) {
+            flags ^= 1;
+            for (uint64_t i = 0; i < num_in; ++i) {
+                tx.m_has_witness |= SkipWitness(reader);
+            }
+            if (!tx.m_has_witness) {
+                throw std::ios_base::failure("Superfluous witness record");
+            }
+        }
+        if (flags) {
+            throw std::ios_base::failure("Unknown transaction optional data");
+        }
+        reader >> tx.m_locktime;
+
+        tx.m_base = reader.Slice(base_begin, base_end);
+        tx.m_raw = reader.Slice(tx_begin, reader.Pos());
+    }
+    if (!reader.empty()) {
+        throw std::ios_base::failure("BlockView: trailing data");
+    }
+}
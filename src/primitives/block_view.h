@@ -0,0 +1,90 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PRIMITIVES_BLOCK_VIEW_H
+#define BITCOIN_PRIMITIVES_BLOCK_VIEW_H
+
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <span.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** A transaction inside a serialized block. Only valid as long as the owning BlockView is. */
+class TxView
+{
+    friend class BlockView;
+
+    //! Full serialization of the transaction, including witness data if present
+    Span<const std::byte> m_raw;
+    //! Serialized vin and vout, which is identical with and without witness serialization
+    Span<const std::byte> m_base;
+    uint32_t m_version;
+    uint32_t m_locktime;
+    bool m_has_witness;
+
+public:
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (!m_has_witness || s.template GetParams<TransactionSerParams>().allow_witness) {
+            s.write(m_raw);
+            return;
+        }
+        s << m_version;
+        s.write(m_base);
+        s << m_locktime;
+    }
+};
+
+/**
+ * Read-only view of a serialized block, for code paths that only re-serialize
+ * (parts of) a block read from disk.
+ *
+ * The serialized block (in witness format, as stored on disk) is kept in a
+ * single buffer, and parsing only records where each transaction and its
+ * witness-independent part start and end. Serving a block without witnesses,
+ * or a few of its transactions for a getblocktxn request, then costs one
+ * allocation instead of deserializing every transaction, script and witness.
+ *
+ * Parsing applies the same format rules as UnserializeTransaction() and throws
+ * std::ios_base::failure on malformed data.
+ */
+class BlockView
+{
+    std::vector<uint8_t> m_data;
+    std::vector<TxView> m_txs;
+
+public:
+    //! Size of a serialized CBlockHeader
+    static constexpr size_t HEADER_SIZE{80};
+
+    explicit BlockView(std::vector<uint8_t>&& data);
+
+    BlockView(const BlockView&) = delete;
+    BlockView& operator=(const BlockView&) = delete;
+    // Moving a std::vector keeps its buffer, so spans into it stay valid.
+    BlockView(BlockView&&) = default;
+    BlockView& operator=(BlockView&&) = default;
+
+    Span<const TxView> Transactions() const { return m_txs; }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (s.template GetParams<TransactionSerParams>().allow_witness) {
+            s.write(MakeByteSpan(m_data));
+            return;
+        }
+        s.write(MakeByteSpan(m_data).first(HEADER_SIZE));
+        WriteCompactSize(s, m_txs.size());
+        for (const TxView& tx : m_txs) {
+            s << tx;
+        }
+    }
+};
+
+#endif // BITCOIN_PRIMITIVES_BLOCK_VIEW_H
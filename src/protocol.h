@@ -497,6 +497,7 @@ public:
     CInv(uint32_t typeIn, const uint256& hashIn);
 
     SERIALIZE_METHODS(CInv, obj) { READWRITE(obj.type, obj.hash); }
+    using TriviallySerializableType = CInv;
 
     friend bool operator<(const CInv& a, const CInv& b);
 
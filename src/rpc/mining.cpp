@@ -793,8 +793,9 @@ static RPCHelpMan getblocktemplate()
     static CBlockIndex* pindexPrev;
     static int64_t time_start;
     static std::unique_ptr<BlockTemplate> block_template;
+    // Getting a template from the block template cache is cheap, so don't wait before updating it.
     if (!pindexPrev || pindexPrev->GetBlockHash() != tip ||
-        (miner.getTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - time_start > 5))
+        (miner.getTransactionsUpdated() != nTransactionsUpdatedLast && (node.block_template_cache || GetTime() - time_start > 5)))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -633,6 +633,14 @@ static RPCHelpMan getnetworkinfo()
                         }},
                         {RPCResult::Type::BOOL, "localrelay", "true if transaction relay is requested from peers"},
                         {RPCResult::Type::NUM, "timeoffset", "the time offset"},
+                        {RPCResult::Type::OBJ, "servedblockcache", /*optional=*/true, "cache of recently served blocks, if enabled (see -servedblockcache)",
+                        {
+                            {RPCResult::Type::NUM, "entries", "number of cached blocks, counting witness and non-witness serializations separately"},
+                            {RPCResult::Type::NUM, "bytes", "size of the cached blocks"},
+                            {RPCResult::Type::NUM, "max_bytes", "memory limit of the cache (-servedblockcache)"},
+                            {RPCResult::Type::NUM, "hits", "number of block requests served from the cache"},
+                            {RPCResult::Type::NUM, "misses", "number of block requests read from disk"},
+                        }},
                         {RPCResult::Type::NUM, "connections", "the total number of connections"},
                         {RPCResult::Type::NUM, "connections_in", "the number of inbound connections"},
                         {RPCResult::Type::NUM, "connections_out", "the number of outbound connections"},
@@ -690,6 +698,15 @@ static RPCHelpMan getnetworkinfo()
         auto peerman_info{node.peerman->GetInfo()};
         obj.pushKV("localrelay", !peerman_info.ignores_incoming_txs);
         obj.pushKV("timeoffset", Ticks<std::chrono::seconds>(peerman_info.median_outbound_time_offset));
+        if (peerman_info.served_block_cache.max_bytes > 0) {
+            UniValue served_block_cache(UniValue::VOBJ);
+            served_block_cache.pushKV("entries", uint64_t(peerman_info.served_block_cache.entries));
+            served_block_cache.pushKV("bytes", uint64_t(peerman_info.served_block_cache.bytes));
+            served_block_cache.pushKV("max_bytes", uint64_t(peerman_info.served_block_cache.max_bytes));
+            served_block_cache.pushKV("hits", peerman_info.served_block_cache.hits);
+            served_block_cache.pushKV("misses", peerman_info.served_block_cache.misses);
+            obj.pushKV("servedblockcache", std::move(served_block_cache));
+        }
     }
     if (node.connman) {
         obj.pushKV("networkactive", node.connman->GetNetworkActive());
@@ -13,6 +13,7 @@
 #include <span.h>
 
 #include <algorithm>
+#include <bit>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
@@ -284,6 +285,24 @@ template <typename Stream> inline void Serialize(Stream& s, bool a) { uint8_t f
 template <typename Stream> inline void Unserialize(Stream& s, bool& a) { uint8_t f = ser_readdata8(s); a = f; }
 // clang-format on
 
+/**
+ * Types whose serialization is exactly their in-memory representation, so that
+ * a contiguous array of them can be written or read with a single copy.
+ *
+ * This holds for the fixed-width integers on little-endian platforms, and for
+ * classes that serialize exactly their members, in declaration order, and opt in
+ * with `using TriviallySerializableType = <the class itself>;`. Since the alias
+ * must name the class itself, a derived class does not inherit the opt-in.
+ * Padding is ruled out by std::has_unique_object_representations.
+ */
+template <typename T>
+concept TriviallySerializable =
+    std::endian::native == std::endian::little &&
+    std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T> &&
+    (std::same_as<T, int8_t> || std::same_as<T, int16_t> || std::same_as<T, uint16_t> ||
+     std::same_as<T, int32_t> || std::same_as<T, uint32_t> || std::same_as<T, int64_t> || std::same_as<T, uint64_t> ||
+     std::same_as<typename T::TriviallySerializableType, T>);
+
 
 /**
  * Compact Size
@@ -842,9 +861,9 @@ void Unserialize(Stream& is, prevector<N, T>& v)
 template <typename Stream, typename T, typename A>
 void Serialize(Stream& os, const std::vector<T, A>& v)
 {
-    if constexpr (BasicByte<T>) { // Use optimized version for unformatted basic bytes
+    if constexpr (BasicByte<T> || TriviallySerializable<T>) { // Use optimized version for unformatted basic bytes and trivially serializable types
         WriteCompactSize(os, v.size());
-        if (!v.empty()) os.write(MakeByteSpan(v));
+        if (!v.empty()) os.write(AsBytes(Span{v}));
     } else if constexpr (std::is_same_v<T, bool>) {
         // A special case for std::vector<bool>, as dereferencing
         // std::vector<bool>::const_iterator does not result in a const bool&
@@ -862,7 +881,7 @@ void Serialize(Stream& os, const std::vector<T, A>& v)
 template <typename Stream, typename T, typename A>
 void Unserialize(Stream& is, std::vector<T, A>& v)
 {
-    if constexpr (BasicByte<T>) { // Use optimized version for unformatted basic bytes
+    if constexpr (BasicByte<T> || TriviallySerializable<T>) { // Use optimized version for unformatted basic bytes and trivially serializable types
         // Limit size per read so bogus size value won't cause out of memory
         v.clear();
         unsigned int nSize = ReadCompactSize(is);
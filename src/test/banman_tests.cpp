@@ -7,9 +7,12 @@
 #include <netbase.h>
 #include <streams.h>
 #include <test/util/logging.h>
+#include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <util/readwritefile.h>
 
+#include <map>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -40,4 +43,77 @@ BOOST_AUTO_TEST_CASE(file)
     }
 }
 
+BOOST_AUTO_TEST_CASE(subnet_trie)
+{
+    // Use few distinct leading bytes so that subnets nest and overlap.
+    const auto rand_addr{[&](bool ipv4) {
+        std::vector<uint8_t> bytes(ipv4 ? ADDR_IPV4_SIZE : ADDR_IPV6_SIZE);
+        for (auto& b : bytes) b = m_rng.randbool() ? m_rng.randbits(2) : m_rng.rand<uint8_t>();
+        if (!ipv4) bytes[0] = 0x20;
+        CNetAddr addr;
+        addr.SetLegacyIPv6(ipv4 ? std::vector<uint8_t>{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, bytes[0], bytes[1], bytes[2], bytes[3]} : bytes);
+        return addr;
+    }};
+
+    SubNetTrie trie;
+    std::map<CSubNet, int64_t> subnets;
+    for (int i{0}; i < 500; ++i) {
+        const bool ipv4{m_rng.randbool()};
+        const CSubNet sub_net{rand_addr(ipv4), static_cast<uint8_t>(m_rng.randrange(ipv4 ? 33 : 129))};
+        const int64_t ban_until{static_cast<int64_t>(m_rng.randrange(100))};
+        trie.Insert(sub_net, ban_until);
+        subnets[sub_net] = ban_until;
+    }
+    // Erasing a subnet leaves the ones nested in it or containing it.
+    for (int i{0}; i < 100; ++i) {
+        const auto it{std::next(subnets.begin(), m_rng.randrange(subnets.size()))};
+        trie.Erase(it->first);
+        subnets.erase(it);
+    }
+
+    for (int i{0}; i < 1000; ++i) {
+        const CNetAddr addr{rand_addr(m_rng.randbool())};
+        const int64_t now{static_cast<int64_t>(m_rng.randrange(100))};
+        bool banned{false};
+        for (const auto& [sub_net, ban_until] : subnets) {
+            banned |= now < ban_until && sub_net.Match(addr);
+        }
+        BOOST_CHECK_EQUAL(trie.Match(addr, now), banned);
+    }
+
+    // Subnets of other networks only match the exact address.
+    CNetAddr onion;
+    BOOST_REQUIRE(onion.SetSpecial("pg6mmjiyjmcrsslvykfwnntlaru7p5svn6y2ymmju6nubxndf4pscryd.onion"));
+    trie.Insert(CSubNet{onion}, 10);
+    BOOST_CHECK(trie.Match(onion, 5));
+    BOOST_CHECK(!trie.Match(onion, 10));
+    trie.Erase(CSubNet{onion});
+    BOOST_CHECK(!trie.Match(onion, 5));
+}
+
+BOOST_AUTO_TEST_CASE(ban_subnet)
+{
+    SetMockTime(1000s);
+    BanMan banman{m_args.GetDataDirBase() / "banlist_subnet", /*client_interface=*/nullptr, /*default_ban_time=*/60};
+    const CSubNet sub_net{LookupSubNet("1.2.0.0/16")};
+    const CNetAddr inside{*Assert(LookupHost("1.2.3.4", /*fAllowLookup=*/false))};
+    const CNetAddr outside{*Assert(LookupHost("1.3.3.4", /*fAllowLookup=*/false))};
+
+    banman.Ban(sub_net);
+    banman.Ban(outside, /*ban_time_offset=*/10);
+    BOOST_CHECK(banman.IsBanned(inside));
+    BOOST_CHECK(banman.IsBanned(outside));
+    BOOST_CHECK(banman.Unban(sub_net));
+    BOOST_CHECK(!banman.IsBanned(inside));
+
+    // Expired bans no longer match.
+    SetMockTime(1011s);
+    BOOST_CHECK(!banman.IsBanned(outside));
+    banman.Ban(inside);
+    BOOST_CHECK(banman.IsBanned(inside));
+    banman.ClearBanned();
+    BOOST_CHECK(!banman.IsBanned(inside));
+    SetMockTime(0s);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <node/block_template_cache.h>
+#include <node/miner.h>
+#include <script/script.h>
+#include <test/util/setup_common.h>
+#include <txmempool.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+using node::BlockAssembler;
+using node::BlockTemplateCache;
+using node::CBlockTemplate;
+
+BOOST_FIXTURE_TEST_SUITE(block_template_cache_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(block_template_cache)
+{
+    const CScript p2pk{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    const CScript op_true{CScript() << OP_TRUE};
+    // Let the first three coinbase outputs mature.
+    for (int i{0}; i < 2; ++i) CreateAndProcessBlock({}, op_true);
+
+    BlockTemplateCache cache{*m_node.chainman, *m_node.mempool, BlockAssembler::Options{}};
+    m_node.validation_signals->RegisterValidationInterface(&cache);
+    const auto get{[&] {
+        m_node.validation_signals->SyncWithValidationInterfaceQueue();
+        return cache.Get(op_true);
+    }};
+    const auto contains{[](const CBlockTemplate& block_template, const CTransactionRef& tx) {
+        return std::ranges::any_of(block_template.block.vtx, [&](const auto& block_tx) { return block_tx->GetHash() == tx->GetHash(); });
+    }};
+    const auto check_valid{[&](CBlock block) {
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+        BlockValidationState state;
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(block.hashPrevBlock, m_node.chainman->ActiveChain().Tip()->GetBlockHash());
+        BOOST_CHECK(TestBlockValidity(state, m_node.chainman->GetParams(), m_node.chainman->ActiveChainstate(), block,
+                                      m_node.chainman->ActiveChain().Tip(), /*fCheckPOW=*/false, /*fCheckMerkleRoot=*/true));
+    }};
+
+    // The template is built on first use.
+    auto block_template{get()};
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 1U);
+    BOOST_CHECK(block_template->block.vtx[0]->vout[0].scriptPubKey == op_true);
+    BOOST_CHECK_EQUAL(cache.GetStats().builds, 1U);
+
+    // Transactions entering the mempool are appended, including children of transactions in the template.
+    const CTransactionRef parent{MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[0], 0, 1, coinbaseKey, p2pk, 49 * COIN))};
+    const CTransactionRef child{MakeTransactionRef(CreateValidMempoolTransaction(parent, 0, 101, coinbaseKey, p2pk, 48 * COIN))};
+    const CTransactionRef other{MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[1], 0, 2, coinbaseKey, p2pk, 49 * COIN))};
+    block_template = get();
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 4U);
+    BOOST_CHECK(contains(*block_template, parent) && contains(*block_template, child) && contains(*block_template, other));
+    BOOST_CHECK_EQUAL(block_template->vTxFees[0], -3 * COIN);
+    BOOST_CHECK_EQUAL(cache.GetStats().builds, 1U);
+    BOOST_CHECK_EQUAL(cache.GetStats().txs_appended, 3U);
+    check_valid(block_template->block);
+
+    // The coinbase pays to the requested script; the rest of the template is shared.
+    const auto other_template{cache.Get(p2pk)};
+    BOOST_CHECK(other_template->block.vtx[0]->vout[0].scriptPubKey == p2pk);
+    BOOST_CHECK(std::equal(block_template->block.vtx.begin() + 1, block_template->block.vtx.end(), other_template->block.vtx.begin() + 1));
+
+    // A transaction leaving the mempool is removed together with its descendants.
+    {
+        LOCK(m_node.mempool->cs);
+        m_node.mempool->removeRecursive(*parent, MemPoolRemovalReason::CONFLICT);
+    }
+    block_template = get();
+    BOOST_CHECK_EQUAL(block_template->block.vtx.size(), 2U);
+    BOOST_CHECK(contains(*block_template, other));
+    BOOST_CHECK_EQUAL(block_template->vTxFees[0], -1 * COIN);
+    BOOST_CHECK_EQUAL(cache.GetStats().txs_removed, 2U);
+    check_valid(block_template->block);
+
+    // A new tip rebuilds the template from the callback, before it is asked for.
+    CreateAndProcessBlock({}, op_true);
+    m_node.validation_signals->SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(cache.GetStats().builds, 2U);
+    block_template = get();
+    BOOST_CHECK_EQUAL(cache.GetStats().builds, 2U);
+    BOOST_CHECK(contains(*block_template, other));
+    check_valid(block_template->block);
+
+    const CTransactionRef next{MakeTransactionRef(CreateValidMempoolTransaction(m_coinbase_txns[2], 0, 3, coinbaseKey, p2pk, 49 * COIN))};
+    block_template = get();
+    BOOST_CHECK(contains(*block_template, next));
+    BOOST_CHECK_EQUAL(cache.GetStats().builds, 2U);
+    check_valid(block_template->block);
+
+    m_node.validation_signals->UnregisterValidationInterface(&cache);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockencodings.h>
+#include <consensus/merkle.h>
+#include <primitives/block.h>
+#include <primitives/block_view.h>
+#include <streams.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <ios>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(block_view_tests, BasicTestingSetup)
+
+static CBlock BuildBlock(FastRandomContext& ctx)
+{
+    CBlock block;
+    block.nVersion = 42;
+    block.hashPrevBlock = ctx.rand256();
+    block.nBits = 0x207fffff;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_0 << OP_1;
+    coinbase.vin[0].scriptWitness.stack.emplace_back(32, 0);
+    coinbase.vout.resize(2);
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(36, 0xaa);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    for (int i = 0; i < 10; ++i) {
+        CMutableTransaction tx;
+        tx.version = 2;
+        tx.nLockTime = i;
+        tx.vin.resize(1 + i % 3);
+        for (size_t in = 0; in < tx.vin.size(); ++in) {
+            tx.vin[in].prevout = COutPoint{Txid::FromUint256(ctx.rand256()), static_cast<uint32_t>(in)};
+            tx.vin[in].nSequence = ctx.rand32();
+            // Mix legacy-only and witness transactions, and inputs with empty stacks.
+            if (i % 2 == 0 && in % 2 == 0) {
+                tx.vin[in].scriptWitness.stack = {ctx.randbytes(72), ctx.randbytes(33)};
+            } else if (i % 2 == 1) {
+                tx.vin[in].scriptSig = CScript() << ctx.randbytes(71);
+            }
+        }
+        tx.vout.resize(1 + i % 2);
+        for (auto& out : tx.vout) {
+            out.nValue = ctx.randrange(COIN);
+            out.scriptPubKey = CScript() << OP_1 << ctx.randbytes(32);
+        }
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+template <typename T>
+static std::vector<uint8_t> ToBytes(const T& obj)
+{
+    std::vector<uint8_t> ret;
+    VectorWriter{ret, 0, obj};
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(block_view_matches_block)
+{
+    const CBlock block{BuildBlock(m_rng)};
+    const BlockView view{ToBytes(TX_WITH_WITNESS(block))};
+
+    BOOST_REQUIRE_EQUAL(view.Transactions().size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx{*block.vtx[i]};
+        const TxView& tx_view{view.Transactions()[i]};
+        BOOST_CHECK(ToBytes(TX_WITH_WITNESS(tx_view)) == ToBytes(TX_WITH_WITNESS(tx)));
+        BOOST_CHECK(ToBytes(TX_NO_WITNESS(tx_view)) == ToBytes(TX_NO_WITNESS(tx)));
+    }
+
+    BOOST_CHECK(ToBytes(TX_WITH_WITNESS(view)) == ToBytes(TX_WITH_WITNESS(block)));
+    BOOST_CHECK(ToBytes(TX_NO_WITNESS(view)) == ToBytes(TX_NO_WITNESS(block)));
+
+    // Spans stay valid when the view is moved.
+    BlockView original{ToBytes(TX_WITH_WITNESS(block))};
+    const BlockView moved{std::move(original)};
+    BOOST_CHECK(ToBytes(TX_NO_WITNESS(moved)) == ToBytes(TX_NO_WITNESS(block)));
+}
+
+BOOST_AUTO_TEST_CASE(block_view_blocktxn)
+{
+    // A blocktxn message built from a view matches one built from the block.
+    const CBlock block{BuildBlock(m_rng)};
+    const BlockView view{ToBytes(TX_WITH_WITNESS(block))};
+
+    BlockTransactionsRequest req;
+    req.blockhash = block.GetHash();
+    req.indexes = {1, 2, 5, 10};
+    BlockTransactions resp{req};
+    std::vector<TxView> txn;
+    for (size_t i = 0; i < req.indexes.size(); ++i) {
+        resp.txn[i] = block.vtx[req.indexes[i]];
+        txn.push_back(view.Transactions()[req.indexes[i]]);
+    }
+    std::vector<uint8_t> from_view;
+    VectorWriter{from_view, 0, req.blockhash, TX_WITH_WITNESS(txn)};
+    BOOST_CHECK(from_view == ToBytes(resp));
+}
+
+BOOST_AUTO_TEST_CASE(block_view_malformed)
+{
+    const CBlock block{BuildBlock(m_rng)};
+    const std::vector<uint8_t> serialized{ToBytes(TX_WITH_WITNESS(block))};
+
+    // Truncated at any point
+    for (size_t len : {size_t{0}, size_t{79}, size_t{81}, serialized.size() / 2, serialized.size() - 1}) {
+        BOOST_CHECK_THROW(BlockView{std::vector<uint8_t>(serialized.begin(), serialized.begin() + len)}, std::ios_base::failure);
+    }
+
+    // Trailing data
+    std::vector<uint8_t> trailing{serialized};
+    trailing.push_back(0);
+    BOOST_CHECK_THROW(BlockView{std::move(trailing)}, std::ios_base::failure);
+
+    // A witness marker with only empty witness stacks is rejected, as in UnserializeTransaction().
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    std::vector<uint8_t> superfluous{ToBytes(block.GetBlockHeader())};
+    superfluous.push_back(1); // one transaction
+    const std::vector<uint8_t> tx_ser{ToBytes(TX_NO_WITNESS(tx))};
+    superfluous.insert(superfluous.end(), tx_ser.begin(), tx_ser.begin() + 4); // version
+    superfluous.insert(superfluous.end(), {0x00, 0x01}); // marker and flags
+    superfluous.insert(superfluous.end(), tx_ser.begin() + 4, tx_ser.end() - 4); // vin and vout
+    superfluous.push_back(0x00); // empty witness stack
+    superfluous.insert(superfluous.end(), tx_ser.end() - 4, tx_ser.end()); // locktime
+    BOOST_CHECK_THROW(BlockView{std::vector<uint8_t>{superfluous}}, std::ios_base::failure);
+    CBlock check;
+    BOOST_CHECK_THROW(SpanReader{superfluous} >> TX_WITH_WITNESS(check), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
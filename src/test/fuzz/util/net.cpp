@@ -164,6 +164,15 @@ ssize_t FuzzedSock::Send(const void* data, size_t len, int flags) const
     return r;
 }
 
+ssize_t FuzzedSock::SendMany(Span<const Span<const unsigned char>> pieces, int flags) const
+{
+    // A short write of the first piece is a valid result of sendmsg(2) too.
+    for (const auto& piece : pieces) {
+        if (!piece.empty()) return Send(piece.data(), piece.size(), flags);
+    }
+    return 0;
+}
+
 ssize_t FuzzedSock::Recv(void* buf, size_t len, int flags) const
 {
     // Have a permanent error at recv_errnos[0] because when the fuzzed data is exhausted
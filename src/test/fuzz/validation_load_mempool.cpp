@@ -55,7 +55,8 @@ FUZZ_TARGET(validation_load_mempool, .init = initialize_validation_load_mempool)
     (void)LoadMempool(pool, MempoolPath(g_setup->m_args), chainstate,
                       {
                           .mockable_fopen_function = fuzzed_fopen,
+                          .skip_script_checks_on_same_tip = fuzzed_data_provider.ConsumeBool(),
                       });
     pool.SetLoadTried(true);
-    (void)DumpMempool(pool, MempoolPath(g_setup->m_args), fuzzed_fopen, true);
+    (void)DumpMempool(pool, MempoolPath(g_setup->m_args), chainstate, fuzzed_fopen, true);
 }
@@ -0,0 +1,88 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <node/headers_cache.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+#include <util/strencodings.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using node::HeadersCache;
+
+BOOST_FIXTURE_TEST_SUITE(headers_cache_tests, BasicTestingSetup)
+
+static void CheckCache(const HeadersCache& cache, const CChain& chain)
+{
+    BOOST_REQUIRE_EQUAL(cache.Size(), chain.Height() + 1);
+    for (int height = 0; height <= chain.Height(); ++height) {
+        DataStream expected;
+        expected << chain[height]->GetBlockHeader() << uint8_t{0};
+        BOOST_CHECK_EQUAL(HexStr(cache.GetHeaders(height, 1)), HexStr(expected));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(headers_cache_follows_chain)
+{
+    // Blocks 0-19 are a chain of heights 0-19, blocks 20-29 a fork of heights 10-19 off block 9.
+    std::vector<uint256> hashes(30);
+    std::vector<CBlockIndex> blocks(30);
+    for (int i = 0; i < 30; ++i) {
+        hashes[i] = m_rng.rand256();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].nVersion = 4;
+        blocks[i].hashMerkleRoot = m_rng.rand256();
+        blocks[i].nTime = 1000 + i;
+        blocks[i].nBits = 0x207fffff;
+        blocks[i].nNonce = m_rng.rand32();
+        blocks[i].nHeight = i < 20 ? i : i - 10;
+        blocks[i].pprev = i == 0 ? nullptr : i == 20 ? &blocks[9] : &blocks[i - 1];
+        blocks[i].BuildSkip();
+    }
+
+    CChain chain;
+    HeadersCache cache;
+    cache.Update(chain);
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+
+    chain.SetTip(blocks[14]);
+    cache.Update(chain);
+    CheckCache(cache, chain);
+
+    // Extending the chain appends
+    chain.SetTip(blocks[19]);
+    cache.Update(chain);
+    CheckCache(cache, chain);
+
+    // A reorg truncates to the fork point first
+    chain.SetTip(blocks[25]);
+    cache.Update(chain);
+    CheckCache(cache, chain);
+
+    chain.SetTip(blocks[5]);
+    cache.Update(chain);
+    CheckCache(cache, chain);
+
+    // A range is a headers message payload without the leading count
+    chain.SetTip(blocks[29]);
+    cache.Update(chain);
+    CheckCache(cache, chain);
+    DataStream message;
+    message << COMPACTSIZE(uint64_t{5}) << cache.GetHeaders(12, 5);
+    std::vector<CBlock> headers;
+    message >> TX_WITH_WITNESS(headers);
+    BOOST_REQUIRE_EQUAL(headers.size(), 5U);
+    for (int i = 0; i < 5; ++i) {
+        BOOST_CHECK_EQUAL(headers[i].hashPrevBlock, chain[12 + i]->pprev->GetBlockHash());
+        BOOST_CHECK_EQUAL(headers[i].nNonce, chain[12 + i]->nNonce);
+        BOOST_CHECK(headers[i].vtx.empty());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
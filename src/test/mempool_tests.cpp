@@ -7,6 +7,7 @@
 #include <test/util/txmempool.h>
 #include <txmempool.h>
 #include <util/time.h>
+#include <util/translation.h>
 
 #include <test/util/setup_common.h>
 
@@ -599,6 +600,85 @@ inline CTransactionRef make_tx(std::vector<CAmount>&& output_values, std::vector
     return MakeTransactionRef(tx);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolChunkEvictionTest)
+{
+    auto opts{MemPoolOptionsForTest(m_node)};
+    opts.chunk_eviction = true;
+    bilingual_str error;
+    CTxMemPool pool{opts, error};
+    BOOST_REQUIRE(error.empty());
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+    const auto exists{[&](const CTransactionRef& tx) { return pool.exists(GenTxid::Txid(tx->GetHash())); }};
+
+    // A parent with a child that pays for it and a child that doesn't, and an unrelated transaction.
+    const CTransactionRef parent{make_tx(/*output_values=*/{10 * COIN, 10 * COIN})};
+    const CTransactionRef cpfp_child{make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{parent}, /*input_indices=*/{0})};
+    const CTransactionRef low_child{make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{parent}, /*input_indices=*/{1})};
+    const CTransactionRef other{make_tx(/*output_values=*/{5 * COIN})};
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(parent));
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(cpfp_child));
+    pool.addUnchecked(entry.Fee(2000LL).FromTx(low_child));
+    pool.addUnchecked(entry.Fee(2500LL).FromTx(other));
+
+    // The worst chunk is the child that doesn't pay for its parent; the parent stays with the other child.
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(exists(parent) && exists(cpfp_child) && exists(other));
+    BOOST_CHECK(!exists(low_child));
+    BOOST_CHECK_EQUAL(pool.GetMinFee().GetFeePerK(), CFeeRate(2000, GetVirtualTransactionSize(*low_child)).GetFeePerK() + 1000);
+
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(exists(parent) && exists(cpfp_child));
+    BOOST_CHECK(!exists(other));
+
+    // Prioritisation is taken into account.
+    const CTransactionRef prioritised{make_tx(/*output_values=*/{4 * COIN})};
+    const CTransactionRef unprioritised{make_tx(/*output_values=*/{3 * COIN})};
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(prioritised));
+    pool.addUnchecked(entry.Fee(3000LL).FromTx(unprioritised));
+    pool.PrioritiseTransaction(prioritised->GetHash(), 100000LL);
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(exists(prioritised));
+    BOOST_CHECK(!exists(unprioritised));
+
+    // When the parent is mined, its child is left in a cluster of its own.
+    pool.removeForBlock({parent}, 1);
+    BOOST_CHECK(exists(cpfp_child));
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!exists(cpfp_child));
+    BOOST_CHECK(exists(prioritised));
+
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+}
+
+
+BOOST_AUTO_TEST_CASE(MempoolEntrySnapshotsTest)
+{
+    CTxMemPool& pool = *Assert(m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A child added before its parent is still described after it.
+    const CTransactionRef parent{make_tx(/*output_values=*/{10 * COIN, 10 * COIN})};
+    const CTransactionRef child{make_tx(/*output_values=*/{10 * COIN}, /*inputs=*/{parent}, /*input_indices=*/{0})};
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(child));
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(parent));
+    pool.UpdateTransactionsFromBlock({parent->GetHash().ToUint256()});
+    pool.AddUnbroadcastTx(child->GetHash());
+
+    const auto snapshots{pool.GetEntrySnapshots()};
+    BOOST_REQUIRE_EQUAL(snapshots.size(), 2U);
+    BOOST_CHECK_EQUAL(snapshots[0].tx, parent);
+    BOOST_CHECK(snapshots[0].parents.empty());
+    BOOST_CHECK(snapshots[0].children == std::vector<Txid>{child->GetHash()});
+    BOOST_CHECK_EQUAL(snapshots[0].mod_fees_with_descendants, 21000);
+    BOOST_CHECK(!snapshots[0].unbroadcast);
+    BOOST_CHECK_EQUAL(snapshots[1].tx, child);
+    BOOST_CHECK(snapshots[1].parents == std::vector<Txid>{parent->GetHash()});
+    BOOST_CHECK_EQUAL(snapshots[1].count_with_ancestors, 2U);
+    BOOST_CHECK(snapshots[1].unbroadcast);
+}
 
 BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
 {
@@ -804,4 +884,51 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTestsDiamond)
     BOOST_CHECK_EQUAL(descendants, 4ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSortByDepthAndScoreTest)
+{
+    CTxMemPool& pool = *Assert(m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    const auto make_tx{[](const std::optional<COutPoint>& prevout, CAmount value) {
+        CMutableTransaction tx;
+        if (prevout) {
+            tx.vin.resize(1);
+            tx.vin[0].prevout = *prevout;
+            tx.vin[0].scriptSig = CScript() << OP_11;
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = value;
+        return MakeTransactionRef(tx);
+    }};
+    const CTransactionRef high{make_tx(std::nullopt, 1 * COIN)};
+    const CTransactionRef parent{make_tx(std::nullopt, 2 * COIN)};
+    const CTransactionRef child{make_tx(COutPoint{parent->GetHash(), 0}, 1 * COIN)};
+    const CTransactionRef low{make_tx(std::nullopt, 3 * COIN)};
+    const CTransactionRef missing{make_tx(std::nullopt, 4 * COIN)};
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(high));
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(parent));
+    pool.addUnchecked(entry.Fee(50000LL).FromTx(child));
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(low));
+
+    // Transactions not in the mempool come first, then by ancestor count and feerate.
+    std::vector<GenTxid> gtxids{
+        GenTxid::Txid(child->GetHash()),
+        GenTxid::Wtxid(low->GetWitnessHash()),
+        GenTxid::Txid(parent->GetHash()),
+        GenTxid::Txid(missing->GetHash()),
+        GenTxid::Wtxid(high->GetWitnessHash()),
+    };
+    pool.SortByDepthAndScore(gtxids);
+    const std::vector<GenTxid> expected{
+        GenTxid::Txid(missing->GetHash()),
+        GenTxid::Wtxid(high->GetWitnessHash()),
+        GenTxid::Txid(parent->GetHash()),
+        GenTxid::Wtxid(low->GetWitnessHash()),
+        GenTxid::Txid(child->GetHash()),
+    };
+    BOOST_CHECK(gtxids == expected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
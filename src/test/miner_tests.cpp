@@ -33,7 +33,8 @@ using node::CBlockTemplate;
 
 namespace miner_tests {
 struct MinerTestingSetup : public TestingSetup {
-    void TestPackageSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    void TestPackageSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst, bool cluster_linearization) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+    void TestClusterSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     void TestBasicMining(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst, int baseheight) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     void TestPrioritisedMining(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
     bool TestSequenceLocks(const CTransaction& tx, CTxMemPool& tx_mempool) EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
@@ -54,7 +55,7 @@ struct MinerTestingSetup : public TestingSetup {
         Assert(error.empty());
         return *m_node.mempool;
     }
-    BlockAssembler AssemblerForTest(CTxMemPool& tx_mempool);
+    BlockAssembler AssemblerForTest(CTxMemPool& tx_mempool, bool cluster_linearization = false, size_t block_max_weight = MAX_BLOCK_WEIGHT);
 };
 } // namespace miner_tests
 
@@ -62,12 +63,13 @@ BOOST_FIXTURE_TEST_SUITE(miner_tests, MinerTestingSetup)
 
 static CFeeRate blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
 
-BlockAssembler MinerTestingSetup::AssemblerForTest(CTxMemPool& tx_mempool)
+BlockAssembler MinerTestingSetup::AssemblerForTest(CTxMemPool& tx_mempool, bool cluster_linearization, size_t block_max_weight)
 {
     BlockAssembler::Options options;
 
-    options.nBlockMaxWeight = MAX_BLOCK_WEIGHT;
+    options.nBlockMaxWeight = block_max_weight;
     options.blockMinFeeRate = blockMinFeeRate;
+    options.cluster_linearization = cluster_linearization;
     return BlockAssembler{m_node.chainman->ActiveChainstate(), &tx_mempool, options};
 }
 
@@ -105,7 +107,7 @@ static std::unique_ptr<CBlockIndex> CreateBlockIndex(int nHeight, CBlockIndex* a
 // Test suite for ancestor feerate transaction selection.
 // Implemented as an additional function, rather than a separate test case,
 // to allow reusing the blockchain created in CreateNewBlock_validity.
-void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst)
+void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst, bool cluster_linearization)
 {
     CTxMemPool& tx_mempool{MakeMempool()};
     LOCK(tx_mempool.cs);
@@ -137,7 +139,7 @@ void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const
     Txid hashHighFeeTx = tx.GetHash();
     tx_mempool.addUnchecked(entry.Fee(50000).Time(Now<NodeSeconds>()).SpendsCoinbase(false).FromTx(tx));
 
-    std::unique_ptr<CBlockTemplate> pblocktemplate = AssemblerForTest(tx_mempool).CreateNewBlock(scriptPubKey);
+    std::unique_ptr<CBlockTemplate> pblocktemplate = AssemblerForTest(tx_mempool, cluster_linearization).CreateNewBlock(scriptPubKey);
     BOOST_REQUIRE_EQUAL(pblocktemplate->block.vtx.size(), 4U);
     BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashParentTx);
     BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashHighFeeTx);
@@ -158,7 +160,7 @@ void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const
     tx.vout[0].nValue = 5000000000LL - 1000 - 50000 - feeToUse;
     Txid hashLowFeeTx = tx.GetHash();
     tx_mempool.addUnchecked(entry.Fee(feeToUse).FromTx(tx));
-    pblocktemplate = AssemblerForTest(tx_mempool).CreateNewBlock(scriptPubKey);
+    pblocktemplate = AssemblerForTest(tx_mempool, cluster_linearization).CreateNewBlock(scriptPubKey);
     // Verify that the free tx and the low fee tx didn't get selected
     for (size_t i=0; i<pblocktemplate->block.vtx.size(); ++i) {
         BOOST_CHECK(pblocktemplate->block.vtx[i]->GetHash() != hashFreeTx);
@@ -172,7 +174,7 @@ void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const
     tx.vout[0].nValue -= 2; // Now we should be just over the min relay fee
     hashLowFeeTx = tx.GetHash();
     tx_mempool.addUnchecked(entry.Fee(feeToUse + 2).FromTx(tx));
-    pblocktemplate = AssemblerForTest(tx_mempool).CreateNewBlock(scriptPubKey);
+    pblocktemplate = AssemblerForTest(tx_mempool, cluster_linearization).CreateNewBlock(scriptPubKey);
     BOOST_REQUIRE_EQUAL(pblocktemplate->block.vtx.size(), 6U);
     BOOST_CHECK(pblocktemplate->block.vtx[4]->GetHash() == hashFreeTx);
     BOOST_CHECK(pblocktemplate->block.vtx[5]->GetHash() == hashLowFeeTx);
@@ -194,7 +196,7 @@ void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const
     tx.vout[0].nValue = 5000000000LL - 100000000 - feeToUse;
     Txid hashLowFeeTx2 = tx.GetHash();
     tx_mempool.addUnchecked(entry.Fee(feeToUse).SpendsCoinbase(false).FromTx(tx));
-    pblocktemplate = AssemblerForTest(tx_mempool).CreateNewBlock(scriptPubKey);
+    pblocktemplate = AssemblerForTest(tx_mempool, cluster_linearization).CreateNewBlock(scriptPubKey);
 
     // Verify that this tx isn't selected.
     for (size_t i=0; i<pblocktemplate->block.vtx.size(); ++i) {
@@ -207,11 +209,63 @@ void MinerTestingSetup::TestPackageSelection(const CScript& scriptPubKey, const
     tx.vin[0].prevout.n = 1;
     tx.vout[0].nValue = 100000000 - 10000; // 10k satoshi fee
     tx_mempool.addUnchecked(entry.Fee(10000).FromTx(tx));
-    pblocktemplate = AssemblerForTest(tx_mempool).CreateNewBlock(scriptPubKey);
+    pblocktemplate = AssemblerForTest(tx_mempool, cluster_linearization).CreateNewBlock(scriptPubKey);
     BOOST_REQUIRE_EQUAL(pblocktemplate->block.vtx.size(), 9U);
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
 }
 
+// Test that selecting by cluster linearization can collect more fees than by
+// ancestor feerate, when a parent is worth including with all its children.
+void MinerTestingSetup::TestClusterSelection(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst)
+{
+    CTxMemPool& tx_mempool{MakeMempool()};
+    LOCK(tx_mempool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A free parent with two outputs, each spent by a child paying 30k satoshis.
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout = COutPoint{txFirst[0]->GetHash(), 0};
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 2500000000LL;
+    tx.vout[1].nValue = 2500000000LL;
+    const Txid hash_parent{tx.GetHash()};
+    tx_mempool.addUnchecked(entry.Fee(0).Time(Now<NodeSeconds>()).SpendsCoinbase(true).FromTx(tx));
+    const int64_t parent_size{entry.FromTx(tx).GetTxSize()};
+
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 2500000000LL - 30000;
+    std::vector<Txid> hash_children;
+    for (uint32_t n : {0, 1}) {
+        tx.vin[0].prevout = COutPoint{hash_parent, n};
+        hash_children.push_back(tx.GetHash());
+        tx_mempool.addUnchecked(entry.Fee(30000).SpendsCoinbase(false).FromTx(tx));
+    }
+    const int64_t tx_size{entry.FromTx(tx).GetTxSize()};
+
+    // An unrelated transaction with a feerate between the ancestor feerate of
+    // one child and that of the whole cluster.
+    tx.vin[0].prevout = COutPoint{txFirst[1]->GetHash(), 0};
+    tx.vout[0].nValue = 5000000000LL - 16000;
+    const Txid hash_unrelated{tx.GetHash()};
+    tx_mempool.addUnchecked(entry.Fee(16000).SpendsCoinbase(true).FromTx(tx));
+
+    // The block has room for three of these transactions.
+    const size_t block_max_weight{BlockAssembler::Options{}.coinbase_max_additional_weight + WITNESS_SCALE_FACTOR * (parent_size + 2 * tx_size) + 1};
+
+    std::unique_ptr<CBlockTemplate> by_ancestors{AssemblerForTest(tx_mempool, /*cluster_linearization=*/false, block_max_weight).CreateNewBlock(scriptPubKey)};
+    BOOST_REQUIRE_EQUAL(by_ancestors->block.vtx.size(), 4U);
+    BOOST_CHECK(by_ancestors->block.vtx[1]->GetHash() == hash_unrelated);
+    BOOST_CHECK_EQUAL(-by_ancestors->vTxFees[0], 46000);
+
+    std::unique_ptr<CBlockTemplate> by_clusters{AssemblerForTest(tx_mempool, /*cluster_linearization=*/true, block_max_weight).CreateNewBlock(scriptPubKey)};
+    BOOST_REQUIRE_EQUAL(by_clusters->block.vtx.size(), 4U);
+    BOOST_CHECK(by_clusters->block.vtx[1]->GetHash() == hash_parent);
+    BOOST_CHECK(by_clusters->block.vtx[2]->GetHash() == hash_children[0] || by_clusters->block.vtx[2]->GetHash() == hash_children[1]);
+    BOOST_CHECK_EQUAL(-by_clusters->vTxFees[0], 60000);
+}
+
 void MinerTestingSetup::TestBasicMining(const CScript& scriptPubKey, const std::vector<CTransactionRef>& txFirst, int baseheight)
 {
     Txid hash;
@@ -651,7 +705,9 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     m_node.chainman->ActiveChain().Tip()->nHeight--;
     SetMockTime(0);
 
-    TestPackageSelection(scriptPubKey, txFirst);
+    TestPackageSelection(scriptPubKey, txFirst, /*cluster_linearization=*/false);
+    TestPackageSelection(scriptPubKey, txFirst, /*cluster_linearization=*/true);
+    TestClusterSelection(scriptPubKey, txFirst);
 
     m_node.chainman->ActiveChain().Tip()->nHeight--;
     SetMockTime(0);
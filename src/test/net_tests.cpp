@@ -16,6 +16,7 @@
 #include <serialize.h>
 #include <span.h>
 #include <streams.h>
+#include <test/util/net.h>
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <test/util/validation.h>
@@ -27,9 +28,11 @@
 
 #include <algorithm>
 #include <ios>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
+#include <tuple>
 
 using namespace std::literals;
 using namespace util::hex_literals;
@@ -1553,4 +1556,182 @@ BOOST_AUTO_TEST_CASE(v2transport_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(v1transport_shared_payload)
+{
+    const auto payload{std::make_shared<const std::vector<unsigned char>>(std::vector<unsigned char>(1000, 0x42))};
+
+    // Send the shared payload through one transport, and a copy of it through
+    // another. Both must produce the same bytes on the wire.
+    const auto send{[](CSerializedNetMsg msg) {
+        V1Transport sender{/*node_id=*/0};
+        BOOST_REQUIRE(sender.SetMessageToSend(msg));
+        BOOST_CHECK_GE(sender.GetSendMemoryUsage(), 1000U);
+        std::vector<uint8_t> wire;
+        while (true) {
+            const auto& [to_send, _more, msg_type] = sender.GetBytesToSend(/*have_next_message=*/false);
+            if (to_send.empty()) break;
+            BOOST_CHECK_EQUAL(msg_type, "block");
+            wire.insert(wire.end(), to_send.begin(), to_send.end());
+            sender.MarkBytesSent(to_send.size());
+        }
+        return wire;
+    }};
+    CSerializedNetMsg shared;
+    shared.m_type = "block";
+    shared.m_shared_data = payload;
+    BOOST_CHECK_GE(shared.GetMemoryUsage(), 1000U);
+    CSerializedNetMsg copied{shared.Copy()};
+    BOOST_CHECK(copied.data.empty());
+    BOOST_CHECK_EQUAL(payload.use_count(), 3);
+    const std::vector<uint8_t> wire{send(std::move(shared))};
+    // The transport drops its reference once the message is sent.
+    BOOST_CHECK_EQUAL(payload.use_count(), 2);
+    copied.m_shared_data.reset();
+    copied.data = *payload;
+    BOOST_CHECK(wire == send(std::move(copied)));
+
+    V1Transport receiver{/*node_id=*/1};
+    Span<const uint8_t> to_receive{wire};
+    while (!receiver.ReceivedMessageComplete()) {
+        BOOST_REQUIRE(!to_receive.empty());
+        BOOST_REQUIRE(receiver.ReceivedBytes(to_receive));
+    }
+    bool reject{false};
+    CNetMessage msg{receiver.GetReceivedMessage(/*time=*/{}, reject)};
+    BOOST_CHECK(!reject);
+    BOOST_CHECK_EQUAL(msg.m_type, "block");
+    BOOST_CHECK(std::ranges::equal(MakeUCharSpan(msg.m_recv), *payload));
+}
+
+BOOST_AUTO_TEST_CASE(socket_send_coalescing)
+{
+    // Socket that accepts at most m_max_send bytes per call and records them.
+    class RecordingSock : public StaticContentsSock
+    {
+    public:
+        RecordingSock() : StaticContentsSock{""} {}
+        size_t m_max_send{std::numeric_limits<size_t>::max()};
+        mutable int m_calls{0};
+        mutable std::vector<uint8_t> m_sent;
+
+        ssize_t SendMany(Span<const Span<const unsigned char>> pieces, int) const override
+        {
+            ++m_calls;
+            size_t len{0};
+            for (const auto& piece : pieces) {
+                const size_t take{std::min(piece.size(), m_max_send - len)};
+                m_sent.insert(m_sent.end(), piece.begin(), piece.begin() + take);
+                len += take;
+            }
+            return len;
+        }
+    };
+
+    auto& connman{static_cast<ConnmanTestMsg&>(*m_node.connman)};
+    const auto sock{std::make_shared<RecordingSock>()};
+    CNode node{/*id=*/0, sock, CAddress{}, /*nKeyedNetGroupIn=*/0, /*nLocalHostNonceIn=*/0, CAddress{},
+               /*addrNameIn=*/"", ConnectionType::OUTBOUND_FULL_RELAY, /*inbound_onion=*/false};
+    // Each ping is a 24 byte header and an 8 byte nonce.
+    constexpr size_t PING_SIZE{CMessageHeader::HEADER_SIZE + 8};
+    const auto queue_pings{[&]() EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend) {
+        for (uint64_t nonce{0}; nonce < 3; ++nonce) {
+            CSerializedNetMsg msg{NetMsg::Make(NetMsgType::PING, nonce)};
+            node.m_send_memusage += msg.GetMemoryUsage();
+            node.vSendMsg.push_back(std::move(msg));
+        }
+    }};
+
+    LOCK(node.cs_vSend);
+    // All queued messages go out with a single call.
+    queue_pings();
+    auto [bytes_sent, data_left]{connman.SocketSendDataPublic(node)};
+    BOOST_CHECK_EQUAL(sock->m_calls, 1);
+    BOOST_CHECK_EQUAL(bytes_sent, 3 * PING_SIZE);
+    BOOST_CHECK(!data_left);
+    BOOST_CHECK(node.vSendMsg.empty());
+
+    // After a partial send, the remaining bytes follow in order.
+    queue_pings();
+    sock->m_max_send = 40;
+    std::tie(bytes_sent, data_left) = connman.SocketSendDataPublic(node);
+    BOOST_CHECK_EQUAL(bytes_sent, 40U);
+    BOOST_CHECK(data_left);
+    sock->m_max_send = std::numeric_limits<size_t>::max();
+    std::tie(bytes_sent, data_left) = connman.SocketSendDataPublic(node);
+    BOOST_CHECK_EQUAL(bytes_sent, 3 * PING_SIZE - 40);
+    BOOST_CHECK(!data_left);
+    BOOST_CHECK(node.m_send_coalesced.empty());
+    BOOST_CHECK_EQUAL(sock->m_calls, 3);
+
+    V1Transport receiver{/*node_id=*/1};
+    Span<const uint8_t> to_receive{sock->m_sent};
+    for (int i{0}; i < 6; ++i) {
+        while (!receiver.ReceivedMessageComplete()) {
+            BOOST_REQUIRE(!to_receive.empty());
+            BOOST_REQUIRE(receiver.ReceivedBytes(to_receive));
+        }
+        bool reject{false};
+        CNetMessage msg{receiver.GetReceivedMessage(/*time=*/{}, reject)};
+        BOOST_CHECK(!reject);
+        BOOST_CHECK_EQUAL(msg.m_type, NetMsgType::PING);
+        uint64_t nonce;
+        msg.m_recv >> nonce;
+        BOOST_CHECK_EQUAL(nonce, uint64_t(i % 3));
+    }
+    BOOST_CHECK(to_receive.empty());
+}
+
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    RecvBufferPool pool;
+    DataStream small{pool.Get(10)};
+    BOOST_CHECK_EQUAL(small.capacity(), RecvBufferPool::MIN_BUFFER_SIZE);
+    DataStream large{pool.Get(RecvBufferPool::MIN_BUFFER_SIZE + 1)};
+    BOOST_CHECK_EQUAL(large.capacity(), 2 * RecvBufferPool::MIN_BUFFER_SIZE);
+    large << uint32_t{42};
+    const auto* large_data{large.data()};
+
+    // Returned buffers are reused for requests they fit.
+    pool.Put(std::move(large));
+    DataStream reused{pool.Get(300)};
+    BOOST_CHECK(reused.empty());
+    BOOST_CHECK_EQUAL(reused.data(), large_data);
+    BOOST_CHECK_EQUAL(pool.Get(300).capacity(), 2 * RecvBufferPool::MIN_BUFFER_SIZE);
+
+    // Small buffers are not kept, and buffers of the largest class fit any message.
+    DataStream tiny;
+    tiny.reserve(10);
+    pool.Put(std::move(tiny));
+    BOOST_CHECK_EQUAL(pool.Get(MAX_PROTOCOL_MESSAGE_LENGTH).capacity(), RecvBufferPool::MAX_BUFFER_SIZE);
+
+    // A message received in several pieces ends up in a pooled buffer.
+    V1Transport sender{/*node_id=*/0};
+    CSerializedNetMsg msg;
+    msg.m_type = "block";
+    const std::vector<uint8_t> payload(1'000'000, 0x42);
+    msg.data = payload;
+    BOOST_REQUIRE(sender.SetMessageToSend(msg));
+    std::vector<uint8_t> wire;
+    while (true) {
+        const auto& [to_send, _more, _msg_type] = sender.GetBytesToSend(/*have_next_message=*/false);
+        if (to_send.empty()) break;
+        wire.insert(wire.end(), to_send.begin(), to_send.end());
+        sender.MarkBytesSent(to_send.size());
+    }
+    V1Transport receiver{/*node_id=*/1};
+    Span<const uint8_t> to_receive{wire};
+    while (!to_receive.empty()) {
+        Span<const uint8_t> piece{to_receive.first(std::min<size_t>(to_receive.size(), 100'000))};
+        to_receive = to_receive.subspan(piece.size());
+        while (!piece.empty()) BOOST_REQUIRE(receiver.ReceivedBytes(piece));
+    }
+    BOOST_REQUIRE(receiver.ReceivedMessageComplete());
+    bool reject{false};
+    CNetMessage received{receiver.GetReceivedMessage(/*time=*/{}, reject)};
+    BOOST_CHECK(!reject);
+    BOOST_CHECK_GE(received.m_recv.capacity(), size_t{1} << 20);
+    BOOST_CHECK_EQUAL(received.GetMemoryUsage(), received.m_recv.capacity());
+    BOOST_CHECK(std::ranges::equal(MakeUCharSpan(received.m_recv), payload));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,11 +2,18 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or https://www.opensource.org/licenses/mit-license.php.
 
+#include <chain.h>
 #include <chainparams.h>
+#include <net.h>
+#include <netmessagemaker.h>
 #include <node/miner.h>
 #include <net_processing.h>
 #include <pow.h>
+#include <protocol.h>
+#include <streams.h>
+#include <test/util/net.h>
 #include <test/util/setup_common.h>
+#include <util/strencodings.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
@@ -74,4 +81,300 @@ BOOST_AUTO_TEST_CASE(connections_desirable_service_flags)
     BOOST_CHECK(peerman->GetDesirableServiceFlags(peer_flags) == ServiceFlags(NODE_NETWORK | NODE_WITNESS));
 }
 
+/** Send a request to a new peer of peerman and return the payload of the response of the given type. */
+static std::vector<unsigned char> GetResponse(PeerManager& peerman, NodeId id, CSerializedNetMsg request, const std::string& response_type)
+    EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex)
+{
+    CNode peer{id,
+               /*sock=*/nullptr,
+               /*addrIn=*/CAddress{CService{}, NODE_NETWORK},
+               /*nKeyedNetGroupIn=*/0,
+               /*nLocalHostNonceIn=*/0,
+               /*addrBindIn=*/CAddress{},
+               /*addrNameIn=*/std::string{},
+               /*conn_type_in=*/ConnectionType::INBOUND,
+               /*inbound_onion=*/false};
+    peerman.InitializeNode(peer, NODE_NETWORK);
+
+    std::vector<unsigned char> response;
+    const auto capture_orig{CaptureMessage};
+    CaptureMessage = [&](const CAddress&, const std::string& msg_type, Span<const unsigned char> data, bool is_incoming) {
+        if (!is_incoming && msg_type == response_type) response.assign(data.begin(), data.end());
+    };
+    std::atomic<bool> interrupt{false};
+    const auto process{[&](CSerializedNetMsg msg) EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex) {
+        DataStream stream{msg.data};
+        peerman.ProcessMessage(peer, msg.m_type, stream, /*time_received=*/{}, interrupt);
+    }};
+    process(NetMsg::Make(NetMsgType::VERSION,
+                         PROTOCOL_VERSION,
+                         Using<CustomUintFormatter<8>>(NODE_NETWORK | NODE_WITNESS),
+                         int64_t{},                // dummy time
+                         int64_t{},                // ignored service bits
+                         CNetAddr::V1(CService{}), // dummy
+                         int64_t{},                // ignored service bits
+                         CNetAddr::V1(CService{}), // ignored
+                         uint64_t{1},              // dummy nonce
+                         std::string{},            // dummy subver
+                         int32_t{},                // dummy starting_height
+                         /*relay_txs=*/false));
+    process(NetMsg::Make(NetMsgType::VERACK));
+    // Nothing is actually sent, so don't let the queued handshake messages pause responses.
+    peer.fPauseSend = false;
+    process(std::move(request));
+    CaptureMessage = capture_orig;
+    peerman.FinalizeNode(peer);
+    return response;
+}
+
+BOOST_FIXTURE_TEST_CASE(getheaders_cache, TestChain100Setup)
+{
+    LOCK(NetEventsInterface::g_msgproc_mutex);
+    m_node.args->ForceSetArg("-capturemessages", "1");
+
+    // Responses served from the headers cache must be identical to the ones
+    // built from the block index, for any limit on the number of headers.
+    std::vector<std::pair<std::unique_ptr<PeerManager>, std::unique_ptr<PeerManager>>> peermans;
+    for (uint32_t max_headers : {MAX_HEADERS_RESULTS, 5U, 1U, 0U}) {
+        PeerManager::Options cached_opts{.max_headers_result = max_headers, .headers_cache = true};
+        PeerManager::Options uncached_opts{.max_headers_result = max_headers, .headers_cache = false};
+        peermans.emplace_back(PeerManager::make(*m_node.connman, *m_node.addrman, nullptr, *m_node.chainman, *m_node.mempool, *m_node.warnings, cached_opts),
+                              PeerManager::make(*m_node.connman, *m_node.addrman, nullptr, *m_node.chainman, *m_node.mempool, *m_node.warnings, uncached_opts));
+    }
+    NodeId id{0};
+    const auto check{[&](const CBlockLocator& locator, const uint256& hash_stop, size_t expected_max_headers) {
+        for (const auto& [cached, uncached] : peermans) {
+            const auto response{GetResponse(*cached, id++, NetMsg::Make(NetMsgType::GETHEADERS, locator, hash_stop), NetMsgType::HEADERS)};
+            BOOST_CHECK_EQUAL(HexStr(response), HexStr(GetResponse(*uncached, id++, NetMsg::Make(NetMsgType::GETHEADERS, locator, hash_stop), NetMsgType::HEADERS)));
+            std::vector<CBlock> headers;
+            SpanReader{response} >> TX_WITH_WITNESS(headers);
+            BOOST_CHECK_LE(headers.size(), expected_max_headers);
+        }
+    }};
+    const auto block_at{[&](int height) { return WITH_LOCK(cs_main, return m_node.chainman->ActiveChain()[height]); }};
+    const auto locator_at{[&](int height) { return CBlockLocator{{block_at(height)->GetBlockHash()}}; }};
+
+    // Whole chain, and a range up to the tip
+    check(locator_at(0), uint256{}, 100);
+    check(locator_at(90), uint256{}, 10);
+    // Ranges ending at hashStop, including one that is not past the start
+    check(locator_at(50), block_at(60)->GetBlockHash(), 10);
+    check(locator_at(50), block_at(51)->GetBlockHash(), 1);
+    check(locator_at(50), block_at(40)->GetBlockHash(), 50);
+    // A null locator asks for the hashStop header only
+    check(CBlockLocator{}, block_at(70)->GetBlockHash(), 1);
+    // Nothing to send when the peer has our tip
+    check(locator_at(100), uint256{}, 0);
+
+    // Reorg the last 10 blocks away. The cache is truncated to the fork point.
+    // A stale locator entry is skipped, so the response starts after the next one.
+    const uint256 stale_hash{block_at(98)->GetBlockHash()};
+    {
+        BlockValidationState state;
+        BOOST_REQUIRE(m_node.chainman->ActiveChainstate().InvalidateBlock(state, WITH_LOCK(cs_main, return block_at(91))));
+    }
+    for (int i = 0; i < 12; ++i) {
+        CreateAndProcessBlock({}, CScript() << OP_TRUE);
+    }
+    BOOST_REQUIRE_EQUAL(WITH_LOCK(cs_main, return m_node.chainman->ActiveHeight()), 102);
+    check(CBlockLocator{{stale_hash, block_at(80)->GetBlockHash()}}, uint256{}, 22);
+    check(locator_at(85), block_at(95)->GetBlockHash(), 10);
+    check(locator_at(0), uint256{}, 102);
+
+    m_node.args->ForceSetArg("-capturemessages", "0");
+}
+
+BOOST_FIXTURE_TEST_CASE(served_block_cache, TestChain100Setup)
+{
+    LOCK(NetEventsInterface::g_msgproc_mutex);
+    m_node.args->ForceSetArg("-capturemessages", "1");
+
+    // A block that is not the most recent one, so it is read from disk. Its
+    // coinbase has a witness, so the two serializations differ.
+    CBlock block;
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(m_node.chainman->m_blockman.ReadBlockFromDisk(block, *m_node.chainman->ActiveChain()[90]));
+    }
+    BOOST_REQUIRE(block.vtx[0]->HasWitness());
+    DataStream witness_block, stripped_block;
+    witness_block << TX_WITH_WITNESS(block);
+    stripped_block << TX_NO_WITNESS(block);
+
+    NodeId id{0};
+    const auto get_block{[&](PeerManager& peerman, GetDataMsg type) EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex) {
+        return HexStr(GetResponse(peerman, id++, NetMsg::Make(NetMsgType::GETDATA, std::vector<CInv>{{type, block.GetHash()}}), NetMsgType::BLOCK));
+    }};
+    const auto check_stats{[](PeerManager& peerman, size_t entries, uint64_t hits, uint64_t misses) {
+        const auto stats{peerman.GetInfo().served_block_cache};
+        BOOST_CHECK_EQUAL(stats.entries, entries);
+        BOOST_CHECK_EQUAL(stats.hits, hits);
+        BOOST_CHECK_EQUAL(stats.misses, misses);
+    }};
+
+    // Both serializations are cached separately, and a hit returns the same payload as the miss.
+    const auto peerman{PeerManager::make(*m_node.connman, *m_node.addrman, nullptr, *m_node.chainman, *m_node.mempool, *m_node.warnings, {})};
+    BOOST_CHECK_EQUAL(get_block(*peerman, MSG_WITNESS_BLOCK), HexStr(witness_block));
+    check_stats(*peerman, /*entries=*/1, /*hits=*/0, /*misses=*/1);
+    BOOST_CHECK_EQUAL(get_block(*peerman, MSG_BLOCK), HexStr(stripped_block));
+    check_stats(*peerman, /*entries=*/2, /*hits=*/0, /*misses=*/2);
+    BOOST_CHECK_EQUAL(get_block(*peerman, MSG_WITNESS_BLOCK), HexStr(witness_block));
+    check_stats(*peerman, /*entries=*/2, /*hits=*/1, /*misses=*/2);
+    BOOST_CHECK_EQUAL(get_block(*peerman, MSG_BLOCK), HexStr(stripped_block));
+    check_stats(*peerman, /*entries=*/2, /*hits=*/2, /*misses=*/2);
+    BOOST_CHECK_EQUAL(peerman->GetInfo().served_block_cache.bytes, witness_block.size() + stripped_block.size());
+
+    // A disabled cache serves the same payloads and does not count lookups.
+    const auto uncached{PeerManager::make(*m_node.connman, *m_node.addrman, nullptr, *m_node.chainman, *m_node.mempool, *m_node.warnings, {.served_block_cache_bytes = 0})};
+    BOOST_CHECK_EQUAL(get_block(*uncached, MSG_WITNESS_BLOCK), HexStr(witness_block));
+    BOOST_CHECK_EQUAL(get_block(*uncached, MSG_BLOCK), HexStr(stripped_block));
+    check_stats(*uncached, /*entries=*/0, /*hits=*/0, /*misses=*/0);
+
+    m_node.args->ForceSetArg("-capturemessages", "0");
+}
+
+BOOST_AUTO_TEST_CASE(light_messages)
+{
+    ConnmanTestMsg& connman = static_cast<ConnmanTestMsg&>(*m_node.connman);
+    PeerManager& peerman = *m_node.peerman;
+    CNode node{/*id=*/0,
+               /*sock=*/nullptr,
+               /*addrIn=*/CAddress{CService{}, NODE_NETWORK},
+               /*nKeyedNetGroupIn=*/0,
+               /*nLocalHostNonceIn=*/0,
+               /*addrBindIn=*/CAddress{},
+               /*addrNameIn=*/std::string{},
+               /*conn_type_in=*/ConnectionType::INBOUND,
+               /*inbound_onion=*/false};
+    const auto next_sent_type{[&] {
+        LOCK(node.cs_vSend);
+        const auto& [to_send, _more, msg_type] = node.m_transport->GetBytesToSend(/*have_next_message=*/!node.vSendMsg.empty());
+        return to_send.empty() ? std::string{} : msg_type;
+    }};
+
+    // Nothing is processed before the handshake completes.
+    (void)connman.ReceiveMsgFrom(node, NetMsg::Make(NetMsgType::FEEFILTER, CAmount{1000}));
+    BOOST_CHECK(!peerman.ProcessLightMessages(&node));
+    BOOST_CHECK_EQUAL(node.PollMessage()->first.m_type, NetMsgType::FEEFILTER);
+
+    {
+        LOCK(NetEventsInterface::g_msgproc_mutex);
+        connman.Handshake(node,
+                          /*successfully_connected=*/true,
+                          /*remote_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                          /*local_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                          /*version=*/PROTOCOL_VERSION,
+                          /*relay_txs=*/true);
+    }
+    connman.FlushSendBuffer(node);
+    node.fPauseSend = false;
+
+    // Light messages are processed without g_msgproc_mutex.
+    (void)connman.ReceiveMsgFrom(node, NetMsg::Make(NetMsgType::FEEFILTER, CAmount{1000}));
+    BOOST_CHECK(!peerman.ProcessLightMessages(&node));
+    CNodeStateStats stats;
+    BOOST_REQUIRE(peerman.GetNodeStateStats(node.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.m_fee_filter_received, 1000);
+
+    // A light message queued behind another message waits for the message
+    // handler thread, so that the pong still follows the earlier responses.
+    (void)connman.ReceiveMsgFrom(node, NetMsg::Make(NetMsgType::SENDHEADERS));
+    (void)connman.ReceiveMsgFrom(node, NetMsg::Make(NetMsgType::PING, uint64_t{42}));
+    BOOST_CHECK(!peerman.ProcessLightMessages(&node));
+    BOOST_CHECK_EQUAL(next_sent_type(), "");
+    {
+        LOCK(NetEventsInterface::g_msgproc_mutex);
+        BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    }
+    BOOST_CHECK(!peerman.ProcessLightMessages(&node));
+    BOOST_CHECK_EQUAL(next_sent_type(), NetMsgType::PONG);
+    BOOST_CHECK(!node.PollMessage());
+
+    peerman.FinalizeNode(node);
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_validation_queue, TestChain100Setup)
+{
+    ConnmanTestMsg& connman = static_cast<ConnmanTestMsg&>(*m_node.connman);
+    const auto peerman{PeerManager::make(*m_node.connman, *m_node.addrman, nullptr, *m_node.chainman, *m_node.mempool, *m_node.warnings, {.tx_validation_batch = 3})};
+    connman.SetMsgProc(peerman.get());
+    const auto make_node{[](NodeId id) {
+        return new CNode{id,
+                         /*sock=*/nullptr,
+                         /*addrIn=*/CAddress{CService{}, NODE_NETWORK},
+                         /*nKeyedNetGroupIn=*/0,
+                         /*nLocalHostNonceIn=*/0,
+                         /*addrBindIn=*/CAddress{},
+                         /*addrNameIn=*/std::string{},
+                         /*conn_type_in=*/ConnectionType::INBOUND,
+                         /*inbound_onion=*/false};
+    }};
+    CNode& node{*make_node(0)};
+    CNode& other{*make_node(1)};
+    LOCK(NetEventsInterface::g_msgproc_mutex);
+    for (CNode* peer : {&node, &other}) {
+        connman.Handshake(*peer,
+                          /*successfully_connected=*/true,
+                          /*remote_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                          /*local_services=*/ServiceFlags(NODE_NETWORK | NODE_WITNESS),
+                          /*version=*/PROTOCOL_VERSION,
+                          /*relay_txs=*/true);
+        connman.FlushSendBuffer(*peer);
+        connman.AddTestNode(*peer);
+    }
+
+    // A chain of transactions, each spending the previous one.
+    const CScript p2pk{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    std::vector<CTransactionRef> txs{m_coinbase_txns[0]};
+    for (int i{0}; i < 6; ++i) {
+        txs.push_back(MakeTransactionRef(CreateValidMempoolTransaction(txs.back(), 0, /*input_height=*/i == 0 ? 1 : 101, coinbaseKey, p2pk,
+                                                                       (49 - i) * COIN, /*submit=*/false)));
+    }
+    const auto receive{[&](CNode& peer, CSerializedNetMsg msg) { (void)connman.ReceiveMsgFrom(peer, std::move(msg)); peer.fPauseSend = false; }};
+    const auto in_mempool{[&](int i) { return m_node.mempool->exists(GenTxid::Wtxid(txs[i]->GetWitnessHash())); }};
+
+    // Consecutive transactions are validated together once a batch is full, and
+    // the rest before the peer's next other message.
+    for (int i{1}; i <= 4; ++i) receive(node, NetMsg::Make(NetMsgType::TX, TX_WITH_WITNESS(txs[i])));
+    receive(node, NetMsg::Make(NetMsgType::SENDHEADERS));
+    for (int i{0}; i < 3; ++i) BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), 0U);
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(in_mempool(1) && in_mempool(2) && in_mempool(3) && !in_mempool(4));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(in_mempool(4));
+    BOOST_CHECK(!connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(!node.PollMessage());
+
+    // A copy of a queued transaction from another peer is dropped.
+    receive(node, NetMsg::Make(NetMsgType::TX, TX_WITH_WITNESS(txs[5])));
+    receive(other, NetMsg::Make(NetMsgType::TX, TX_WITH_WITNESS(txs[5])));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(!connman.ProcessMessagesOnce(other));
+    BOOST_CHECK(!connman.ProcessMessagesOnce(other));
+    BOOST_CHECK(!in_mempool(5));
+
+    // A block waiting at another peer goes first, once.
+    CBlock block;
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(m_node.chainman->m_blockman.ReadBlockFromDisk(block, *m_node.chainman->ActiveChain().Tip()));
+    }
+    receive(other, NetMsg::Make(NetMsgType::BLOCK, TX_WITH_WITNESS(block)));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(!in_mempool(5));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    BOOST_CHECK(in_mempool(5));
+
+    // Queued transactions are dropped when the peer disconnects.
+    receive(node, NetMsg::Make(NetMsgType::TX, TX_WITH_WITNESS(txs[6])));
+    BOOST_CHECK(connman.ProcessMessagesOnce(node));
+    peerman->FinalizeNode(node);
+    peerman->FinalizeNode(other);
+    BOOST_CHECK(!in_mempool(6));
+    connman.ClearTestNodes();
+    connman.SetMsgProc(m_node.peerman.get());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,9 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <hash.h>
+#include <primitives/block.h>
+#include <protocol.h>
 #include <serialize.h>
 #include <streams.h>
 #include <test/util/setup_common.h>
+#include <uint256.h>
 #include <util/strencodings.h>
 
 #include <stdint.h>
@@ -203,6 +206,73 @@ BOOST_AUTO_TEST_CASE(array)
     BOOST_CHECK(array1 == array2);
 }
 
+template <typename T>
+static void CheckBulkVector(const std::vector<T>& vec)
+{
+    // The bulk path must produce exactly the element-wise serialization.
+    DataStream bulk, elementwise;
+    bulk << vec;
+    elementwise << Using<VectorFormatter<DefaultFormatter>>(vec);
+    BOOST_CHECK_EQUAL(HexStr(bulk), HexStr(elementwise));
+    BOOST_CHECK_EQUAL(GetSerializeSize(vec), bulk.size());
+
+    std::vector<T> read;
+    bulk >> read;
+    BOOST_CHECK(bulk.empty());
+    BOOST_CHECK_EQUAL(read.size(), vec.size());
+    DataStream roundtrip;
+    roundtrip << read;
+    BOOST_CHECK_EQUAL(HexStr(roundtrip), HexStr(elementwise));
+}
+
+BOOST_AUTO_TEST_CASE(vector_trivially_serializable)
+{
+    // Only little-endian platforms serialize integers as their in-memory representation.
+    constexpr bool little_endian{std::endian::native == std::endian::little};
+    static_assert(TriviallySerializable<uint32_t> == little_endian);
+    static_assert(TriviallySerializable<uint256> == little_endian);
+    static_assert(TriviallySerializable<Txid> == little_endian);
+    static_assert(TriviallySerializable<CInv> == little_endian);
+    static_assert(TriviallySerializable<CBlockHeader> == little_endian);
+    static_assert(!TriviallySerializable<bool>);
+    static_assert(!TriviallySerializable<CBlock>);
+    // The opt-in is not inherited, even by a subclass that is trivially copyable.
+    struct ExtendedHeader : CBlockHeader {
+        uint32_t extra;
+    };
+    static_assert(std::is_trivially_copyable_v<ExtendedHeader>);
+    static_assert(!TriviallySerializable<ExtendedHeader>);
+    static_assert(!TriviallySerializable<std::pair<uint32_t, uint256>>);
+
+    std::vector<uint16_t> ints;
+    std::vector<uint256> hashes;
+    std::vector<CInv> invs;
+    std::vector<CBlockHeader> headers;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        ints.push_back(m_rng.rand32());
+        hashes.push_back(m_rng.rand256());
+        invs.emplace_back(m_rng.rand32(), m_rng.rand256());
+        CBlockHeader& header{headers.emplace_back()};
+        header.nVersion = m_rng.rand32();
+        header.hashPrevBlock = m_rng.rand256();
+        header.hashMerkleRoot = m_rng.rand256();
+        header.nTime = m_rng.rand32();
+        header.nBits = m_rng.rand32();
+        header.nNonce = m_rng.rand32();
+    }
+    CheckBulkVector(ints);
+    CheckBulkVector(hashes);
+    CheckBulkVector(invs);
+    CheckBulkVector(headers);
+    CheckBulkVector(std::vector<uint256>{});
+
+    // A bogus size must not allocate more than the data actually present.
+    DataStream truncated;
+    WriteCompactSize(truncated, MAX_SIZE);
+    truncated << hashes[0];
+    BOOST_CHECK_THROW(truncated >> hashes, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(noncanonical)
 {
     // Write some non-canonical CompactSize encodings, and
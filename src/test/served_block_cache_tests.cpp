@@ -0,0 +1,63 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/served_block_cache.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using node::ServedBlockCache;
+
+BOOST_FIXTURE_TEST_SUITE(served_block_cache_tests, BasicTestingSetup)
+
+static ServedBlockCache::Data MakeData(size_t size)
+{
+    return std::make_shared<const std::vector<uint8_t>>(size);
+}
+
+BOOST_AUTO_TEST_CASE(served_block_cache_lru)
+{
+    ServedBlockCache cache{1000};
+    const uint256 a{m_rng.rand256()}, b{m_rng.rand256()}, c{m_rng.rand256()};
+
+    BOOST_CHECK(!cache.Get(a, /*witness=*/true));
+    cache.Insert(a, /*witness=*/true, MakeData(400));
+    cache.Insert(a, /*witness=*/false, MakeData(300));
+    BOOST_CHECK_EQUAL(cache.Get(a, /*witness=*/true)->size(), 400U);
+    BOOST_CHECK_EQUAL(cache.Get(a, /*witness=*/false)->size(), 300U);
+    BOOST_CHECK(!cache.Get(b, /*witness=*/true));
+
+    // Inserting b evicts the least recently used entry, which is the witness serialization of a.
+    cache.Insert(b, /*witness=*/true, MakeData(400));
+    BOOST_CHECK(!cache.Get(a, /*witness=*/true));
+    BOOST_CHECK(cache.Get(a, /*witness=*/false));
+    BOOST_CHECK(cache.Get(b, /*witness=*/true));
+
+    // Blocks larger than the whole cache are not cached.
+    cache.Insert(c, /*witness=*/true, MakeData(1001));
+    BOOST_CHECK(!cache.Get(c, /*witness=*/true));
+
+    const auto stats{cache.GetStats()};
+    BOOST_CHECK_EQUAL(stats.entries, 2U);
+    BOOST_CHECK_EQUAL(stats.bytes, 700U);
+    BOOST_CHECK_EQUAL(stats.max_bytes, 1000U);
+    BOOST_CHECK_EQUAL(stats.hits, 4U);
+    BOOST_CHECK_EQUAL(stats.misses, 4U);
+}
+
+BOOST_AUTO_TEST_CASE(served_block_cache_disabled)
+{
+    ServedBlockCache cache{0};
+    const uint256 hash{m_rng.rand256()};
+    cache.Insert(hash, /*witness=*/true, MakeData(1));
+    BOOST_CHECK(!cache.Get(hash, /*witness=*/true));
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 0U);
+    BOOST_CHECK_EQUAL(cache.GetStats().misses, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -140,6 +140,49 @@ BOOST_AUTO_TEST_CASE(wait)
     waiter.join();
 }
 
+BOOST_AUTO_TEST_CASE(wait_set)
+{
+    SockWaitSet wait_set;
+    int s[2];
+    CreateSocketPair(s);
+    auto sock0{std::make_shared<const Sock>(s[0])};
+    auto sock1{std::make_shared<const Sock>(s[1])};
+
+    Sock::EventsPerSock events_per_sock;
+    events_per_sock.emplace(sock0, Sock::Events{Sock::RECV});
+    BOOST_REQUIRE(wait_set.WaitMany(0ms, events_per_sock));
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock0).occurred, 0);
+
+    BOOST_REQUIRE_EQUAL(sock1->Send("a", 1, 0), 1);
+    BOOST_REQUIRE(wait_set.WaitMany(24h, events_per_sock));
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock0).occurred, Sock::RECV);
+
+    // Changing the requested events of a registered socket.
+    events_per_sock.at(sock0) = Sock::Events{Sock::SEND};
+    BOOST_REQUIRE(wait_set.WaitMany(24h, events_per_sock));
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock0).occurred, Sock::SEND);
+
+    // A new socket that reuses the file descriptor of a closed one is waited on.
+    events_per_sock.clear();
+    sock0.reset();
+    sock1.reset();
+    CreateSocketPair(s);
+    sock0 = std::make_shared<const Sock>(s[0]);
+    sock1 = std::make_shared<const Sock>(s[1]);
+    events_per_sock.emplace(sock0, Sock::Events{Sock::RECV});
+    events_per_sock.emplace(sock1, Sock::Events{Sock::RECV});
+    BOOST_REQUIRE_EQUAL(sock1->Send("b", 1, 0), 1);
+    BOOST_REQUIRE(wait_set.WaitMany(24h, events_per_sock));
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock0).occurred, Sock::RECV);
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock1).occurred, 0);
+
+    // Sockets that are dropped from the set are not reported anymore.
+    events_per_sock.erase(sock0);
+    BOOST_REQUIRE(wait_set.WaitMany(0ms, events_per_sock));
+    BOOST_CHECK_EQUAL(events_per_sock.size(), 1U);
+    BOOST_CHECK_EQUAL(events_per_sock.at(sock1).occurred, 0);
+}
+
 BOOST_AUTO_TEST_CASE(recv_until_terminator_limit)
 {
     constexpr auto timeout = 1min; // High enough so that it is never hit.
@@ -0,0 +1,86 @@
+// Copyright (c) 2024-present The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txinventory.h>
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using node::TxInventoryKnown;
+
+BOOST_FIXTURE_TEST_SUITE(txinventory_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(txinventory_known_peers)
+{
+    TxInventoryKnown known{/*generation_size=*/1000};
+    const uint256 a{m_rng.rand256()}, b{m_rng.rand256()};
+
+    known.Add(/*peer=*/0, a);
+    known.Add(/*peer=*/1, b);
+    BOOST_CHECK(known.Contains(0, a));
+    BOOST_CHECK(!known.Contains(0, b));
+    BOOST_CHECK(!known.Contains(1, a));
+    BOOST_CHECK(known.Contains(1, b));
+    BOOST_CHECK(!known.Contains(2, a));
+
+    // A new peer that takes over the slot of a forgotten one doesn't inherit what it knew.
+    known.ForgetPeer(0);
+    BOOST_CHECK(!known.Contains(0, a));
+    known.Add(/*peer=*/2, b);
+    BOOST_CHECK(!known.Contains(2, a));
+    BOOST_CHECK(known.Contains(2, b));
+    BOOST_CHECK(known.Contains(1, b));
+
+    // Entries grow when there are more than 64 peers, keeping what is known.
+    std::vector<uint256> hashes;
+    for (NodeId peer{3}; peer < 200; ++peer) {
+        hashes.push_back(m_rng.rand256());
+        known.Add(peer, hashes.back());
+        known.Add(peer, b);
+    }
+    for (NodeId peer{3}; peer < 200; ++peer) {
+        BOOST_CHECK(known.Contains(peer, hashes[peer - 3]));
+        BOOST_CHECK(!known.Contains(peer, a));
+        BOOST_CHECK(known.Contains(peer, b));
+    }
+    BOOST_CHECK(known.Contains(1, b));
+    BOOST_CHECK(known.Contains(2, b));
+}
+
+BOOST_AUTO_TEST_CASE(txinventory_known_generations)
+{
+    TxInventoryKnown known{/*generation_size=*/100};
+    std::vector<uint256> hashes;
+    for (int i{0}; i < 300; ++i) hashes.push_back(m_rng.rand256());
+
+    // Hashes are remembered for the current and the previous generation. Peers 0
+    // and 1 take turns, so neither runs into its share of a generation.
+    for (int i{0}; i < 101; ++i) known.Add(/*peer=*/i % 2, hashes[i]);
+    for (int i{0}; i < 101; ++i) BOOST_CHECK(known.Contains(i % 2, hashes[i]));
+
+    // Touching a hash of the previous generation keeps it, including what other peers know.
+    known.Add(/*peer=*/2, hashes[0]);
+    for (int i{101}; i < 200; ++i) known.Add(/*peer=*/i % 2, hashes[i]);
+    BOOST_CHECK(known.Contains(0, hashes[0]));
+    BOOST_CHECK(known.Contains(2, hashes[0]));
+    BOOST_CHECK(!known.Contains(1, hashes[1]));
+    BOOST_CHECK(!known.Contains(0, hashes[2]));
+    BOOST_CHECK(known.Contains(1, hashes[101]));
+    BOOST_CHECK(known.Contains(1, hashes[199]));
+
+    // A single peer can only add half the entries of a generation.
+    TxInventoryKnown flooded{/*generation_size=*/100};
+    for (int i{0}; i < 100; ++i) flooded.Add(/*peer=*/0, hashes[i]);
+    for (int i{0}; i < 50; ++i) BOOST_CHECK(flooded.Contains(0, hashes[i]));
+    for (int i{50}; i < 100; ++i) BOOST_CHECK(!flooded.Contains(0, hashes[i]));
+    flooded.Add(/*peer=*/1, hashes[100]);
+    BOOST_CHECK(flooded.Contains(1, hashes[100]));
+
+    BOOST_CHECK_GT(known.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,14 +4,18 @@
 
 #include <consensus/validation.h>
 #include <key_io.h>
+#include <node/mempool_persist.h>
 #include <policy/packages.h>
 #include <policy/policy.h>
 #include <policy/truc_policy.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <script/script.h>
+#include <streams.h>
 #include <test/util/setup_common.h>
 #include <test/util/txmempool.h>
+#include <util/fs.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <boost/test/unit_test.hpp>
@@ -52,6 +56,106 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK(result.m_state.GetResult() == TxValidationResult::TX_CONSENSUS);
 }
 
+/**
+ * Ensure that script checks of transactions and packages with many inputs, which run on
+ * the script check queue, accept valid scripts and report the failure of invalid ones.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_queued_script_checks, TestChain100Setup)
+{
+    BOOST_CHECK(m_node.chainman->GetCheckQueue().HasThreads());
+    const CScript p2pk{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    const CTransactionRef parent{MakeTransactionRef(CreateValidMempoolTransaction(
+        {m_coinbase_txns[0]}, {COutPoint{m_coinbase_txns[0]->GetHash(), 0}}, /*input_height=*/1, {coinbaseKey},
+        std::vector<CTxOut>(8, CTxOut{6 * COIN, p2pk})))};
+    std::vector<COutPoint> inputs;
+    for (uint32_t i{0}; i < 8; ++i) inputs.emplace_back(parent->GetHash(), i);
+    const CMutableTransaction child{CreateValidMempoolTransaction({parent}, inputs, /*input_height=*/101, {coinbaseKey},
+                                                                  {CTxOut{47 * COIN, p2pk}}, /*submit=*/false)};
+
+    // A signature for another input fails one of the checks.
+    CMutableTransaction bad_child{child};
+    bad_child.vin[5].scriptSig = child.vin[4].scriptSig;
+    {
+        LOCK(cs_main);
+        const MempoolAcceptResult result{m_node.chainman->ProcessTransaction(MakeTransactionRef(bad_child))};
+        BOOST_CHECK(result.m_result_type == MempoolAcceptResult::ResultType::INVALID);
+        BOOST_CHECK(result.m_state.GetResult() == TxValidationResult::TX_CONSENSUS);
+        BOOST_CHECK(result.m_state.GetRejectReason().starts_with("mandatory-script-verify-flag-failed"));
+    }
+
+    const CTransactionRef grandchild{MakeTransactionRef(CreateValidMempoolTransaction(
+        MakeTransactionRef(child), 0, /*input_height=*/101, coinbaseKey, p2pk, 46 * COIN, /*submit=*/false))};
+    const Package package{MakeTransactionRef(child), grandchild};
+    LOCK(cs_main);
+    const auto result{ProcessNewPackage(m_node.chainman->ActiveChainstate(), *m_node.mempool, package, /*test_accept=*/false, /*client_maxfeerate=*/{})};
+    BOOST_CHECK_MESSAGE(result.m_state.IsValid(), result.m_state.ToString());
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(child.GetHash())));
+    BOOST_CHECK(m_node.mempool->exists(GenTxid::Txid(grandchild->GetHash())));
+}
+
+/**
+ * Ensure that a dumped mempool is loaded in batches, and that scripts are only trusted
+ * when the file checksum is valid and the tip did not change since it was dumped.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_load_trusted, TestChain100Setup)
+{
+    CTxMemPool& pool{*m_node.mempool};
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+    const CScript p2pk{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    const CTransactionRef parent{MakeTransactionRef(CreateValidMempoolTransaction(
+        {m_coinbase_txns[0]}, {COutPoint{m_coinbase_txns[0]->GetHash(), 0}}, /*input_height=*/1, {coinbaseKey},
+        std::vector<CTxOut>(8, CTxOut{6 * COIN, p2pk})))};
+    std::vector<COutPoint> inputs;
+    for (uint32_t i{0}; i < 8; ++i) inputs.emplace_back(parent->GetHash(), i);
+    const CTransactionRef child{MakeTransactionRef(CreateValidMempoolTransaction({parent}, inputs, /*input_height=*/101, {coinbaseKey},
+                                                                                 {CTxOut{47 * COIN, p2pk}}))};
+    // A transaction with a signature for another one is only accepted without script checks.
+    CMutableTransaction bad{CreateValidMempoolTransaction(m_coinbase_txns[1], 0, /*input_height=*/2, coinbaseKey, p2pk, 49 * COIN, /*submit=*/false)};
+    bad.vin[0].scriptSig = parent->vin[0].scriptSig;
+    const auto add_bad{[&] {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(TestMemPoolEntryHelper{}.Fee(1 * COIN).Time(Now<NodeSeconds>()).FromTx(bad));
+    }};
+    add_bad();
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+
+    const fs::path dump_path{m_args.GetDataDirNet() / "mempool.dat"};
+    BOOST_REQUIRE(node::DumpMempool(pool, dump_path, chainstate));
+    const auto load{[&](bool trusted) {
+        {
+            LOCK(pool.cs);
+            pool.removeRecursive(*parent, MemPoolRemovalReason::CONFLICT);
+            if (pool.exists(GenTxid::Txid(bad.GetHash()))) pool.removeRecursive(CTransaction{bad}, MemPoolRemovalReason::CONFLICT);
+        }
+        BOOST_CHECK_EQUAL(pool.size(), 0U);
+        BOOST_CHECK(node::LoadMempool(pool, dump_path, chainstate, {.skip_script_checks_on_same_tip = trusted}));
+        return pool.size();
+    }};
+
+    // Children are accepted after their parents, also when scripts are trusted.
+    BOOST_CHECK_EQUAL(load(/*trusted=*/false), 2U);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(child->GetHash())));
+    BOOST_CHECK_EQUAL(load(/*trusted=*/true), 3U);
+    BOOST_CHECK(pool.exists(GenTxid::Txid(child->GetHash())));
+
+    // A damaged file is checked fully.
+    {
+        AutoFile file{fsbridge::fopen(dump_path, "r+b")};
+        file.seek(-1, SEEK_END);
+        uint8_t last;
+        file >> last;
+        file.seek(-1, SEEK_END);
+        file << uint8_t(last ^ 1);
+    }
+    BOOST_CHECK_EQUAL(load(/*trusted=*/true), 2U);
+
+    // So is one dumped on another tip.
+    add_bad();
+    BOOST_REQUIRE(node::DumpMempool(pool, dump_path, chainstate));
+    CreateAndProcessBlock({}, p2pk);
+    BOOST_CHECK_EQUAL(load(/*trusted=*/true), 2U);
+}
+
 // Generate a number of random, nonexistent outpoints.
 static inline std::vector<COutPoint> random_outpoints(size_t num_outpoints) {
     std::vector<COutPoint> outpoints;
@@ -87,6 +87,11 @@ struct ConnmanTestMsg : public CConnman {
 
     bool AlreadyConnectedPublic(const CAddress& addr) { return AlreadyConnectedToAddress(addr); };
 
+    std::pair<size_t, bool> SocketSendDataPublic(CNode& node) const EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend)
+    {
+        return SocketSendData(node);
+    }
+
     CNode* ConnectNodePublic(PeerManager& peerman, const char* pszDest, ConnectionType conn_type)
         EXCLUSIVE_LOCKS_REQUIRED(!m_unused_i2p_sessions_mutex);
 };
@@ -157,6 +162,13 @@ public:
 
     ssize_t Send(const void*, size_t len, int) const override { return len; }
 
+    ssize_t SendMany(Span<const Span<const unsigned char>> pieces, int) const override
+    {
+        size_t len{0};
+        for (const auto& piece : pieces) len += piece.size();
+        return len;
+    }
+
     ssize_t Recv(void* buf, size_t len, int flags) const override
     {
         const size_t consume_bytes{std::min(len, m_contents.size() - m_consumed)};
@@ -360,4 +360,51 @@ BOOST_AUTO_TEST_CASE(witness_commitment_index)
 
     BOOST_CHECK_EQUAL(GetWitnessCommitmentIndex(pblock), 2);
 }
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_batch)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    const CBlockIndex* genesis{WITH_LOCK(cs_main, return chainman.ActiveChain().Tip())};
+
+    // A run of headers in which only the 11th has invalid proof of work
+    std::vector<CBlockHeader> headers;
+    uint256 prev_hash{genesis->GetBlockHash()};
+    uint32_t time{genesis->nTime};
+    for (int i = 0; i < 20; ++i) {
+        CBlockHeader& header{headers.emplace_back()};
+        header.nVersion = 4;
+        header.hashPrevBlock = prev_hash;
+        header.hashMerkleRoot = m_rng.rand256();
+        header.nTime = ++time;
+        header.nBits = genesis->nBits;
+        while (CheckProofOfWork(header.GetHash(), header.nBits, Params().GetConsensus()) != (i != 10)) {
+            ++header.nNonce;
+        }
+        prev_hash = header.GetHash();
+    }
+
+    // Headers before the invalid one are accepted, the rest are not.
+    BlockValidationState state;
+    const CBlockIndex* last{nullptr};
+    BOOST_CHECK(!chainman.ProcessNewBlockHeaders(headers, /*min_pow_checked=*/true, state, &last));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_REQUIRE(last);
+    BOOST_CHECK_EQUAL(last->GetBlockHash(), headers[9].GetHash());
+    BOOST_CHECK_EQUAL(last->nHeight, genesis->nHeight + 10);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!chainman.m_blockman.LookupBlockIndex(headers[10].GetHash()));
+        BOOST_CHECK(!chainman.m_blockman.LookupBlockIndex(headers[11].GetHash()));
+        BOOST_CHECK_EQUAL(chainman.m_best_header, last);
+    }
+
+    // Already known headers are accepted again without changes.
+    state = {};
+    last = nullptr;
+    BOOST_CHECK(chainman.ProcessNewBlockHeaders(std::span{headers}.first(10), /*min_pow_checked=*/true, state, &last));
+    BOOST_CHECK(state.IsValid());
+    BOOST_REQUIRE(last);
+    BOOST_CHECK_EQUAL(last->GetBlockHash(), headers[9].GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <txmempool.h>
 
 #include <chain.h>
+#include <cluster_linearize.h>
 #include <coins.h>
 #include <common/system.h>
 #include <consensus/consensus.h>
@@ -16,6 +17,7 @@
 #include <policy/settings.h>
 #include <random.h>
 #include <tinyformat.h>
+#include <util/bitset.h>
 #include <util/check.h>
 #include <util/feefrac.h>
 #include <util/moneystr.h>
@@ -467,6 +469,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     for (const auto& pit : GetIterSet(setParentTransactions)) {
             UpdateParent(newit, pit, true);
     }
+    if (m_opts.chunk_eviction) AddToCluster(newit);
     UpdateAncestorsOf(true, newit, setAncestors);
     UpdateEntryForAncestors(newit, setAncestors);
 
@@ -510,6 +513,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     RemoveUnbroadcastTx(it->GetTx().GetHash(), true /* add logging because unchecked */);
 
+    if (m_opts.chunk_eviction) RemoveFromCluster(it);
+
     if (txns_randomized.size() > 1) {
         // Update idx_randomized of the to-be-moved entry.
         Assert(GetEntry(txns_randomized.back()->GetHash()))->idx_randomized = it->idx_randomized;
@@ -700,6 +705,15 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
         };
         assert(setParentCheck.size() == it->GetMemPoolParentsConst().size());
         assert(std::equal(setParentCheck.begin(), setParentCheck.end(), it->GetMemPoolParentsConst().begin(), comp));
+        if (m_opts.chunk_eviction) {
+            // Parents are in the same cluster, and before the transaction unless the cluster has to be linearized again.
+            const EvictionCluster& cluster{m_eviction_clusters.at(it->m_cluster_id)};
+            assert(cluster.txs.at(it->m_cluster_pos) == it);
+            for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+                assert(parent.m_cluster_id == it->m_cluster_id);
+                assert(cluster.relinearize || parent.m_cluster_pos < it->m_cluster_pos);
+            }
+        }
         // Verify ancestor state is correct.
         auto ancestors{AssumeCalculateMemPoolAncestors(__func__, *it, Limits::NoLimits())};
         uint64_t nCountCheck = ancestors.size() + 1;
@@ -756,6 +770,18 @@ void CTxMemPool::check(const CCoinsViewCache& active_coins_tip, int64_t spendhei
     assert(totalTxSize == checkTotal);
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
+    if (m_opts.chunk_eviction) {
+        size_t cluster_txs{0}, clean_clusters{0};
+        for (const auto& [id, cluster] : m_eviction_clusters) {
+            cluster_txs += std::count_if(cluster.txs.begin(), cluster.txs.end(), [&](txiter it) { return it != mapTx.end(); });
+            if (!cluster.dirty) {
+                ++clean_clusters;
+                assert(m_worst_chunks.contains({cluster.chunks.back().first, id}));
+            }
+        }
+        assert(cluster_txs == mapTx.size());
+        assert(m_worst_chunks.size() == clean_clusters);
+    }
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb, bool wtxid)
@@ -794,6 +820,22 @@ public:
 };
 } // namespace
 
+void CTxMemPool::SortByDepthAndScore(std::vector<GenTxid>& gtxids) const
+{
+    LOCK(cs);
+    std::vector<std::pair<indexed_transaction_set::const_iterator, GenTxid>> entries;
+    entries.reserve(gtxids.size());
+    for (const GenTxid& gtxid : gtxids) {
+        entries.emplace_back(gtxid.IsWtxid() ? get_iter_from_wtxid(gtxid.GetHash()) : mapTx.find(gtxid.GetHash()), gtxid);
+    }
+    std::sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) {
+        if (b.first == mapTx.end()) return false;
+        if (a.first == mapTx.end()) return true;
+        return DepthAndScoreComparator()(a.first, b.first);
+    });
+    for (size_t i{0}; i < entries.size(); ++i) gtxids[i] = entries[i].second;
+}
+
 std::vector<CTxMemPool::indexed_transaction_set::const_iterator> CTxMemPool::GetSortedDepthAndScore() const
 {
     std::vector<indexed_transaction_set::const_iterator> iters;
@@ -824,6 +866,48 @@ std::vector<CTxMemPoolEntryRef> CTxMemPool::entryAll() const
     return ret;
 }
 
+MempoolEntrySnapshot CTxMemPool::GetEntrySnapshot(const CTxMemPoolEntry& entry) const
+{
+    AssertLockHeld(cs);
+    MempoolEntrySnapshot snapshot{
+        .tx = entry.GetSharedTx(),
+        .fee = entry.GetFee(),
+        .modified_fee = entry.GetModifiedFee(),
+        .vsize = entry.GetTxSize(),
+        .weight = entry.GetTxWeight(),
+        .time = entry.GetTime(),
+        .height = entry.GetHeight(),
+        .count_with_descendants = entry.GetCountWithDescendants(),
+        .size_with_descendants = entry.GetSizeWithDescendants(),
+        .mod_fees_with_descendants = entry.GetModFeesWithDescendants(),
+        .count_with_ancestors = entry.GetCountWithAncestors(),
+        .size_with_ancestors = entry.GetSizeWithAncestors(),
+        .mod_fees_with_ancestors = entry.GetModFeesWithAncestors(),
+        .parents = {},
+        .children = {},
+        .unbroadcast = m_unbroadcast_txids.contains(entry.GetTx().GetHash()),
+    };
+    snapshot.parents.reserve(entry.GetMemPoolParentsConst().size());
+    for (const CTxMemPoolEntry& parent : entry.GetMemPoolParentsConst()) snapshot.parents.push_back(parent.GetTx().GetHash());
+    snapshot.children.reserve(entry.GetMemPoolChildrenConst().size());
+    for (const CTxMemPoolEntry& child : entry.GetMemPoolChildrenConst()) snapshot.children.push_back(child.GetTx().GetHash());
+    return snapshot;
+}
+
+std::vector<MempoolEntrySnapshot> CTxMemPool::GetEntrySnapshots() const
+{
+    LOCK(cs);
+    auto iters = GetSortedDepthAndScore();
+
+    std::vector<MempoolEntrySnapshot> ret;
+    ret.reserve(mapTx.size());
+    for (auto it : iters) {
+        ret.push_back(GetEntrySnapshot(*it));
+    }
+
+    return ret;
+}
+
 std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
 {
     LOCK(cs);
@@ -883,6 +967,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, [&nFeeDelta](CTxMemPoolEntry& e) { e.UpdateModifiedFee(nFeeDelta); });
+            if (m_opts.chunk_eviction) MarkClusterDirty(it->m_cluster_id, /*relinearize=*/true);
             // Now update all ancestors' modified fees with descendants
             auto ancestors{AssumeCalculateMemPoolAncestors(__func__, *it, Limits::NoLimits(), /*fSearchForParents=*/false)};
             for (txiter ancestorIt : ancestors) {
@@ -1028,7 +1113,13 @@ void CCoinsViewMemPool::Reset()
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 15 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(txns_randomized) + cachedInnerUsage;
+    size_t usage{memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(txns_randomized) + cachedInnerUsage};
+    if (m_opts.chunk_eviction) {
+        // Estimate the transactions and chunks of the clusters to take one slot per transaction each.
+        usage += memusage::DynamicUsage(m_eviction_clusters) + memusage::DynamicUsage(m_worst_chunks) + memusage::DynamicUsage(m_dirty_clusters) +
+                 mapTx.size() * (sizeof(txiter) + sizeof(std::pair<FeeFrac, uint32_t>));
+    }
+    return usage;
 }
 
 void CTxMemPool::RemoveUnbroadcastTx(const uint256& txid, const bool unchecked) {
@@ -1088,6 +1179,8 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     CTxMemPoolEntry::Parents s;
     if (add && entry->GetMemPoolParents().insert(*parent).second) {
         cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
+        // A transaction being added is indexed once it is linked to all its parents.
+        if (m_opts.chunk_eviction && entry->m_cluster_id != 0) MergeClusters(entry->m_cluster_id, parent->m_cluster_id);
     } else if (!add && entry->GetMemPoolParents().erase(*parent)) {
         cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
     }
@@ -1131,19 +1224,24 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        setEntries stage;
+        CFeeRate removed;
+        if (m_opts.chunk_eviction) {
+            removed = StageWorstChunks(stage, DynamicMemoryUsage() - sizelimit);
+        } else {
+            indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+            removed = CFeeRate(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+            CalculateDescendants(mapTx.project<0>(it), stage);
+        }
 
         // We set the new mempool min fee to the feerate of the removed set, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
         removed += m_opts.incremental_relay_feerate;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1168,6 +1266,222 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     }
 }
 
+/** Clusters with more transactions than this are not linearized. */
+using ClusterSet = BitSet<64>;
+/** Search effort spent on linearizing a single cluster. */
+static constexpr uint64_t MAX_LINEARIZATION_ITERATIONS{10'000};
+
+void LinearizeCluster(std::vector<CTxMemPool::txiter>& cluster, FastRandomContext& rng)
+{
+    if (cluster.size() == 1) return;
+    if (cluster.size() > ClusterSet::Size()) {
+        std::sort(cluster.begin(), cluster.end(), [](const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) {
+            if (a->GetCountWithAncestors() != b->GetCountWithAncestors()) {
+                return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+            }
+            return CompareIteratorByHash()(a, b);
+        });
+        return;
+    }
+
+    cluster_linearize::DepGraph<ClusterSet> depgraph;
+    std::unordered_map<const CTxMemPoolEntry*, cluster_linearize::ClusterIndex> positions;
+    for (const auto& it : cluster) {
+        positions.emplace(&*it, depgraph.AddTransaction({it->GetModifiedFee(), static_cast<int32_t>(it->GetTxSize())}));
+    }
+    for (const auto& it : cluster) {
+        ClusterSet parents;
+        for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+            parents.Set(positions.at(&parent));
+        }
+        depgraph.AddDependencies(parents, positions.at(&*it));
+    }
+
+    auto [linearization, optimal]{cluster_linearize::Linearize(depgraph, MAX_LINEARIZATION_ITERATIONS, rng.rand64())};
+    cluster_linearize::PostLinearize(depgraph, linearization);
+    std::vector<CTxMemPool::txiter> ordered;
+    ordered.reserve(cluster.size());
+    for (cluster_linearize::ClusterIndex i : linearization) {
+        ordered.push_back(cluster[i]);
+    }
+    cluster = std::move(ordered);
+}
+
+void CTxMemPool::AddToCluster(txiter it)
+{
+    AssertLockHeld(cs);
+    uint64_t id{0};
+    for (const CTxMemPoolEntry& parent : it->GetMemPoolParentsConst()) {
+        id = id == 0 ? parent.m_cluster_id : MergeClusters(id, parent.m_cluster_id);
+    }
+    if (id == 0) return AddCluster({it});
+
+    EvictionCluster& cluster{m_eviction_clusters.at(id)};
+    it->m_cluster_id = id;
+    it->m_cluster_pos = cluster.txs.size();
+    cluster.txs.push_back(it);
+    if (cluster.dirty) return;
+    // Appending a child keeps the linearization valid; it only absorbs the trailing chunks with a lower feerate.
+    m_worst_chunks.erase({cluster.chunks.back().first, id});
+    std::pair<FeeFrac, uint32_t> chunk{{it->GetModifiedFee(), static_cast<int32_t>(it->GetTxSize())}, it->m_cluster_pos + 1};
+    while (!cluster.chunks.empty() && chunk.first >> cluster.chunks.back().first) {
+        chunk.first += cluster.chunks.back().first;
+        cluster.chunks.pop_back();
+    }
+    cluster.chunks.push_back(chunk);
+    m_worst_chunks.emplace(chunk.first, id);
+}
+
+void CTxMemPool::AddCluster(std::vector<txiter> txs)
+{
+    AssertLockHeld(cs);
+    const uint64_t id{m_next_cluster_id++};
+    EvictionCluster cluster;
+    cluster.txs = std::move(txs);
+    for (uint32_t i{0}; i < cluster.txs.size(); ++i) {
+        const txiter it{cluster.txs[i]};
+        it->m_cluster_id = id;
+        it->m_cluster_pos = i;
+        std::pair<FeeFrac, uint32_t> chunk{{it->GetModifiedFee(), static_cast<int32_t>(it->GetTxSize())}, i + 1};
+        // Absorb the preceding chunks that have a lower feerate.
+        while (!cluster.chunks.empty() && chunk.first >> cluster.chunks.back().first) {
+            chunk.first += cluster.chunks.back().first;
+            cluster.chunks.pop_back();
+        }
+        cluster.chunks.push_back(chunk);
+    }
+    m_worst_chunks.emplace(cluster.chunks.back().first, id);
+    m_eviction_clusters.emplace(id, std::move(cluster));
+}
+
+void CTxMemPool::MarkClusterDirty(uint64_t id, bool relinearize)
+{
+    AssertLockHeld(cs);
+    EvictionCluster& cluster{m_eviction_clusters.at(id)};
+    cluster.relinearize |= relinearize;
+    if (cluster.dirty) return;
+    m_worst_chunks.erase({cluster.chunks.back().first, id});
+    cluster.dirty = true;
+    m_dirty_clusters.push_back(id);
+}
+
+uint64_t CTxMemPool::MergeClusters(uint64_t a, uint64_t b)
+{
+    AssertLockHeld(cs);
+    if (a == b) return a;
+    if (m_eviction_clusters.at(a).txs.size() < m_eviction_clusters.at(b).txs.size()) std::swap(a, b);
+    const auto from{m_eviction_clusters.find(b)};
+    MarkClusterDirty(a, /*relinearize=*/true);
+    if (!from->second.dirty) m_worst_chunks.erase({from->second.chunks.back().first, b});
+    auto& txs{m_eviction_clusters.at(a).txs};
+    for (const txiter it : from->second.txs) {
+        if (it == mapTx.end()) continue;
+        it->m_cluster_id = a;
+        it->m_cluster_pos = txs.size();
+        txs.push_back(it);
+    }
+    m_eviction_clusters.erase(from);
+    return a;
+}
+
+void CTxMemPool::RemoveFromCluster(txiter it)
+{
+    AssertLockHeld(cs);
+    // Transactions of an evicted chunk were detached already.
+    if (it->m_cluster_id == 0) return;
+    MarkClusterDirty(it->m_cluster_id, /*relinearize=*/false);
+    m_eviction_clusters.at(it->m_cluster_id).txs[it->m_cluster_pos] = mapTx.end();
+}
+
+void CTxMemPool::UpdateDirtyClusters()
+{
+    AssertLockHeld(cs);
+    std::optional<FastRandomContext> rng;
+    for (const uint64_t id : m_dirty_clusters) {
+        const auto cluster{m_eviction_clusters.find(id)};
+        if (cluster == m_eviction_clusters.end()) continue;
+        std::vector<txiter> members;
+        members.reserve(cluster->second.txs.size());
+        std::copy_if(cluster->second.txs.begin(), cluster->second.txs.end(), std::back_inserter(members), [&](txiter it) { return it != mapTx.end(); });
+        const bool relinearize{cluster->second.relinearize};
+        m_eviction_clusters.erase(cluster);
+
+        // Removals may have disconnected the cluster. Number the connected parts, and
+        // collect each part's transactions in the order of the linearization.
+        for (const txiter it : members) it->m_cluster_id = 0;
+        uint64_t parts{0};
+        for (const txiter member : members) {
+            if (member->m_cluster_id != 0) continue;
+            member->m_cluster_id = ++parts;
+            std::vector<const CTxMemPoolEntry*> todo{&*member};
+            while (!todo.empty()) {
+                const CTxMemPoolEntry& entry{*todo.back()};
+                todo.pop_back();
+                const auto visit{[&](const CTxMemPoolEntry& relative) {
+                    if (relative.m_cluster_id != 0) return;
+                    relative.m_cluster_id = parts;
+                    todo.push_back(&relative);
+                }};
+                for (const CTxMemPoolEntry& parent : entry.GetMemPoolParentsConst()) visit(parent);
+                for (const CTxMemPoolEntry& child : entry.GetMemPoolChildrenConst()) visit(child);
+            }
+        }
+        std::vector<std::vector<txiter>> split(parts);
+        for (const txiter it : members) split[it->m_cluster_id - 1].push_back(it);
+        for (auto& txs : split) {
+            if (relinearize) {
+                if (!rng) rng.emplace();
+                LinearizeCluster(txs, *rng);
+            }
+            AddCluster(std::move(txs));
+        }
+    }
+    m_dirty_clusters.clear();
+}
+
+/** Transactions after which to stop staging chunks, as removing large sets at once is slower. */
+static constexpr size_t MAX_EVICTION_BATCH_TXS{100};
+
+CFeeRate CTxMemPool::StageWorstChunks(setEntries& stage, size_t excess_usage)
+{
+    AssertLockHeld(cs);
+    UpdateDirtyClusters();
+    // Memory freed by removing a transaction, as accounted for by DynamicMemoryUsage().
+    const auto usage{[&](txiter it) {
+        return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 15 * sizeof(void*)) + it->DynamicMemoryUsage() +
+               memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst()) +
+               it->GetTx().vin.size() * memusage::IncrementalDynamicUsage(mapNextTx) +
+               sizeof(txns_randomized[0]) + sizeof(txiter) + sizeof(std::pair<FeeFrac, uint32_t>);
+    }};
+    FeeFrac max_feerate;
+    size_t staged_usage{0};
+    while (staged_usage < excess_usage && stage.size() < MAX_EVICTION_BATCH_TXS && Assume(!m_worst_chunks.empty())) {
+        const auto [feerate, id]{*m_worst_chunks.begin()};
+        m_worst_chunks.erase(m_worst_chunks.begin());
+        if (max_feerate.IsEmpty() || feerate >> max_feerate) max_feerate = feerate;
+        const auto cluster{m_eviction_clusters.find(id)};
+        auto& txs{cluster->second.txs};
+        auto& chunks{cluster->second.chunks};
+        chunks.pop_back();
+        // The last chunk of a linearization contains the descendants of its transactions.
+        const uint32_t begin{chunks.empty() ? 0 : chunks.back().second};
+        for (uint32_t i{begin}; i < txs.size(); ++i) {
+            txs[i]->m_cluster_id = 0;
+            stage.insert(txs[i]);
+            staged_usage += usage(txs[i]);
+        }
+        txs.resize(begin);
+        // The rest of the linearization and its chunks stay valid, even if the
+        // cluster is no longer connected.
+        if (chunks.empty()) {
+            m_eviction_clusters.erase(cluster);
+        } else {
+            m_worst_chunks.emplace(chunks.back().first, id);
+        }
+    }
+    return CFeeRate{max_feerate.fee, static_cast<uint32_t>(max_feerate.size)};
+}
+
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
     std::vector<txiter> candidates;
@@ -37,10 +37,12 @@
 #include <set>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class CChain;
+class FastRandomContext;
 class ValidationSignals;
 
 struct bilingual_str;
@@ -227,6 +229,30 @@ struct TxMempoolInfo
     int64_t nFeeDelta;
 };
 
+/**
+ * Copy of a mempool entry and its in-mempool parents and children, so that
+ * readers can describe it without holding CTxMemPool::cs.
+ */
+struct MempoolEntrySnapshot
+{
+    CTransactionRef tx;
+    CAmount fee;
+    CAmount modified_fee;
+    int32_t vsize;
+    int32_t weight;
+    std::chrono::seconds time;
+    unsigned int height;
+    uint64_t count_with_descendants;
+    int64_t size_with_descendants;
+    CAmount mod_fees_with_descendants;
+    uint64_t count_with_ancestors;
+    int64_t size_with_ancestors;
+    CAmount mod_fees_with_ancestors;
+    std::vector<Txid> parents;
+    std::vector<Txid> children;
+    bool unbroadcast;
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -476,6 +502,11 @@ public:
     void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     bool CompareDepthAndScore(const uint256& hasha, const uint256& hashb, bool wtxid=false);
+    /**
+     * Sort transactions in the order of CompareDepthAndScore: those not in the mempool
+     * first, then by ancestor count and score. Takes the lock once for the whole sort.
+     */
+    void SortByDepthAndScore(std::vector<GenTxid>& gtxids) const EXCLUSIVE_LOCKS_REQUIRED(!cs);
     bool isSpent(const COutPoint& outpoint) const;
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
@@ -687,6 +718,10 @@ public:
     std::vector<CTxMemPoolEntryRef> entryAll() const EXCLUSIVE_LOCKS_REQUIRED(cs);
     std::vector<TxMempoolInfo> infoAll() const;
 
+    MempoolEntrySnapshot GetEntrySnapshot(const CTxMemPoolEntry& entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Copy all entries, holding cs only for the copy. Parents come before their children. */
+    std::vector<MempoolEntrySnapshot> GetEntrySnapshots() const;
+
     size_t DynamicMemoryUsage() const;
 
     /** Adds a transaction to the unbroadcast set */
@@ -797,6 +832,58 @@ private:
      *  removal.
      */
     void removeUnchecked(txiter entry, MemPoolRemovalReason reason) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /**
+     * Chunk eviction index, maintained when m_opts.chunk_eviction is set.
+     *
+     * Every transaction belongs to a cluster of transactions connected by
+     * spends. A clean cluster keeps a linearization and the feerates of its
+     * chunks, which decrease along the linearization, so its last chunk is
+     * the worst one and contains all its descendants. m_worst_chunks orders the
+     * last chunks of all clean clusters, so TrimToSize() finds the chunks to
+     * evict in O(log n) each without computing descendants, and removes them
+     * together.
+     *
+     * A transaction whose parents are in a single cluster is appended to its
+     * linearization, which stays topologically valid, and only the trailing
+     * chunks are merged. Removing a transaction leaves a gap in the
+     * linearization and marks the cluster dirty. Merging clusters, on a
+     * transaction with parents in several clusters or on a reorg, and
+     * prioritising a transaction also mark the cluster to be linearized again.
+     * Dirty clusters are chunked again, and split up where removals
+     * disconnected them, before the next eviction.
+     */
+    struct EvictionCluster {
+        //! Transactions in linearization order, with mapTx.end() in place of removed ones
+        std::vector<txiter> txs;
+        //! Feerate of each chunk and the position in txs where it ends
+        std::vector<std::pair<FeeFrac, uint32_t>> chunks;
+        //! Whether chunks and the worst chunk entry are out of date
+        bool dirty{false};
+        //! Whether txs has to be linearized again
+        bool relinearize{false};
+    };
+    std::unordered_map<uint64_t, EvictionCluster> m_eviction_clusters GUARDED_BY(cs);
+    //! Worst chunk feerate and id of each clean cluster
+    std::set<std::pair<FeeFrac, uint64_t>> m_worst_chunks GUARDED_BY(cs);
+    //! Clusters to update before the next eviction; may contain clusters that were merged since
+    std::vector<uint64_t> m_dirty_clusters GUARDED_BY(cs);
+    uint64_t m_next_cluster_id GUARDED_BY(cs){1};
+
+    /** Add a transaction to the cluster of its parents, merging their clusters if there are several. */
+    void AddToCluster(txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Chunk a linearized cluster and add it to the index. */
+    void AddCluster(std::vector<txiter> txs) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void MarkClusterDirty(uint64_t id, bool relinearize) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Move the transactions of the smaller of two clusters into the larger one. Returns the id of the result. */
+    uint64_t MergeClusters(uint64_t a, uint64_t b) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void RemoveFromCluster(txiter it) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void UpdateDirtyClusters() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /**
+     * Detach the worst chunks from the index and stage their transactions for removal, until
+     * removing them frees at least excess_usage. Returns the highest feerate of the chunks.
+     */
+    CFeeRate StageWorstChunks(setEntries& stage, size_t excess_usage) EXCLUSIVE_LOCKS_REQUIRED(cs);
 public:
     /** visited marks a CTxMemPoolEntry as having been traversed
      * during the lifetime of the most recently created Epoch::Guard
@@ -818,6 +905,11 @@ public:
     }
 };
 
+/** Order a cluster of mempool transactions so that its chunks have the highest feerates
+ *  possible within the search budget. Clusters of more than 64 transactions are too large
+ *  to linearize and are put in ancestor count order, which is topologically valid. */
+void LinearizeCluster(std::vector<CTxMemPool::txiter>& cluster, FastRandomContext& rng);
+
 /**
  * CCoinsView that brings transactions from a mempool into view.
  * It does not check for spendings by memory pool transactions.
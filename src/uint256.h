@@ -177,6 +177,9 @@ std::optional<uintN_t> FromUserHex(std::string_view input)
  */
 class uint160 : public base_blob<160> {
 public:
+    //! Serialized as the raw bytes of m_data, see TriviallySerializable.
+    using TriviallySerializableType = uint160;
+
     static std::optional<uint160> FromHex(std::string_view str) { return detail::FromHex<uint160>(str); }
     constexpr uint160() = default;
     constexpr explicit uint160(Span<const unsigned char> vch) : base_blob<160>(vch) {}
@@ -189,6 +192,9 @@ public:
  */
 class uint256 : public base_blob<256> {
 public:
+    //! Serialized as the raw bytes of m_data, see TriviallySerializable.
+    using TriviallySerializableType = uint256;
+
     static std::optional<uint256> FromHex(std::string_view str) { return detail::FromHex<uint256>(str); }
     static std::optional<uint256> FromUserHex(std::string_view str) { return detail::FromUserHex<uint256>(str); }
     constexpr uint256() = default;
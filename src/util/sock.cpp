@@ -11,9 +11,18 @@
 #include <util/threadinterrupt.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <typeinfo>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 
 #ifdef USE_POLL
 #include <poll.h>
@@ -47,6 +56,27 @@ ssize_t Sock::Send(const void* data, size_t len, int flags) const
     return send(m_socket, static_cast<const char*>(data), len, flags);
 }
 
+ssize_t Sock::SendMany(Span<const Span<const unsigned char>> pieces, int flags) const
+{
+#ifdef WIN32
+    for (const auto& piece : pieces) {
+        if (!piece.empty()) return Send(piece.data(), piece.size(), flags);
+    }
+    return 0;
+#else
+    std::vector<iovec> iov;
+    iov.reserve(pieces.size());
+    for (const auto& piece : pieces) {
+        if (piece.empty()) continue;
+        iov.push_back({.iov_base = const_cast<unsigned char*>(piece.data()), .iov_len = piece.size()});
+    }
+    msghdr msg{};
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iov.size();
+    return sendmsg(m_socket, &msg, flags);
+#endif
+}
+
 ssize_t Sock::Recv(void* buf, size_t len, int flags) const
 {
     return recv(m_socket, static_cast<char*>(buf), len, flags);
@@ -242,6 +272,123 @@ bool Sock::WaitMany(std::chrono::milliseconds timeout, EventsPerSock& events_per
 #endif /* USE_POLL */
 }
 
+SockWaitSet::SockWaitSet()
+{
+#ifdef USE_EPOLL
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        LogPrintf("Warning: epoll_create1() failed, falling back to poll(): %s\n", SysErrorString(errno));
+    }
+#endif
+}
+
+SockWaitSet::~SockWaitSet()
+{
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+    }
+#endif
+}
+
+#ifdef USE_EPOLL
+bool SockWaitSet::Update(Sock::EventsPerSock& events_per_sock)
+{
+    for (auto& [fd, reg] : m_registered) {
+        reg.events = nullptr;
+    }
+
+    for (auto& [sock, events] : events_per_sock) {
+        // Mocks implement their own WaitMany() and may not have a real file descriptor.
+        const Sock& s{*sock};
+        if (typeid(s) != typeid(Sock)) {
+            return false;
+        }
+
+        auto [it, inserted] = m_registered.try_emplace(sock->m_socket);
+        Registration& reg{it->second};
+        const bool same_sock{!inserted && !reg.sock.owner_before(sock) && !sock.owner_before(reg.sock)};
+
+        if (!same_sock || reg.requested != events.requested) {
+            epoll_event ev{};
+            ev.data.fd = sock->m_socket;
+            if (events.requested & Sock::RECV) {
+                ev.events |= EPOLLIN;
+            }
+            if (events.requested & Sock::SEND) {
+                ev.events |= EPOLLOUT;
+            }
+            // The kernel drops a socket from the epoll set when it is closed, so a
+            // new socket that reuses the file descriptor is normally not in it.
+            int ret{epoll_ctl(m_epoll_fd, same_sock ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, sock->m_socket, &ev)};
+            if (ret != 0 && errno == EEXIST) {
+                ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, sock->m_socket, &ev);
+            } else if (ret != 0 && errno == ENOENT) {
+                ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sock->m_socket, &ev);
+            }
+            if (ret != 0) {
+                m_registered.erase(it);
+                return false;
+            }
+            reg.sock = sock;
+            reg.requested = events.requested;
+        }
+        reg.events = &events;
+    }
+
+    for (auto it{m_registered.begin()}; it != m_registered.end();) {
+        if (it->second.events == nullptr) {
+            // Fails harmlessly if the socket has been closed in the meantime.
+            (void)epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+            it = m_registered.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return true;
+}
+#endif
+
+bool SockWaitSet::WaitMany(std::chrono::milliseconds timeout, Sock::EventsPerSock& events_per_sock)
+{
+    if (events_per_sock.empty()) {
+        return false;
+    }
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1 && Update(events_per_sock)) {
+        m_ready.resize(std::min<size_t>(events_per_sock.size(), std::numeric_limits<int>::max()));
+        const int ready{epoll_wait(m_epoll_fd, m_ready.data(), m_ready.size(), count_milliseconds(timeout))};
+        if (ready == SOCKET_ERROR) {
+            return false;
+        }
+
+        for (auto& [sock, events] : events_per_sock) {
+            events.occurred = 0;
+        }
+        for (int i{0}; i < ready; ++i) {
+            const auto it{m_registered.find(m_ready[i].data.fd)};
+            if (it == m_registered.end() || it->second.events == nullptr) {
+                continue;
+            }
+            Sock::Event& occurred{it->second.events->occurred};
+            if (m_ready[i].events & EPOLLIN) {
+                occurred |= Sock::RECV;
+            }
+            if (m_ready[i].events & EPOLLOUT) {
+                occurred |= Sock::SEND;
+            }
+            if (m_ready[i].events & (EPOLLERR | EPOLLHUP)) {
+                occurred |= Sock::ERR;
+            }
+        }
+
+        return true;
+    }
+#endif
+    return events_per_sock.begin()->first->WaitMany(timeout, events_per_sock);
+}
+
 void Sock::SendComplete(Span<const unsigned char> data,
                         std::chrono::milliseconds timeout,
                         CThreadInterrupt& interrupt) const
@@ -6,6 +6,7 @@
 #define BITCOIN_UTIL_SOCK_H
 
 #include <compat/compat.h>
+#include <span.h>
 #include <util/threadinterrupt.h>
 #include <util/time.h>
 
@@ -13,6 +14,11 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 /**
  * Maximum time to wait for I/O readiness.
@@ -64,6 +70,13 @@ public:
      */
     [[nodiscard]] virtual ssize_t Send(const void* data, size_t len, int flags) const;
 
+    /**
+     * sendmsg(2) wrapper, sending the concatenation of `pieces` with one system call.
+     * Like Send(), it may send fewer bytes than requested. On systems without sendmsg(2)
+     * only the first non-empty piece is sent.
+     */
+    [[nodiscard]] virtual ssize_t SendMany(Span<const Span<const unsigned char>> pieces, int flags) const;
+
     /**
      * recv(2) wrapper. Equivalent to `recv(m_socket, buf, len, flags);`. Code that uses this
      * wrapper can be unit tested if this method is overridden by a mock Sock implementation.
@@ -275,12 +288,64 @@ protected:
     SOCKET m_socket;
 
 private:
+    friend class SockWaitSet;
+
     /**
      * Close `m_socket` if it is not `INVALID_SOCKET`.
      */
     void Close();
 };
 
+/**
+ * Wait on the same, possibly large, set of sockets over and over.
+ *
+ * `Sock::WaitMany()` hands every socket to the kernel on every call, which makes
+ * each wait of the socket handler thread linear in the number of connections.
+ * On Linux this class keeps the sockets registered with an epoll(7) instance
+ * instead: a call only tells the kernel about the sockets whose requested events
+ * changed since the previous call, and the wait itself only costs as much as
+ * the number of ready sockets.
+ *
+ * Elsewhere, if the epoll instance cannot be created, or if any of the sockets is
+ * not a plain `Sock` (e.g. a mock in tests), it falls back to `Sock::WaitMany()`.
+ */
+class SockWaitSet
+{
+public:
+    SockWaitSet();
+    ~SockWaitSet();
+
+    SockWaitSet(const SockWaitSet&) = delete;
+    SockWaitSet& operator=(const SockWaitSet&) = delete;
+
+    /**
+     * Same as `Sock::WaitMany()`. Sockets that are not in `events_per_sock`
+     * anymore are unregistered.
+     */
+    [[nodiscard]] bool WaitMany(std::chrono::milliseconds timeout, Sock::EventsPerSock& events_per_sock);
+
+private:
+#ifdef USE_EPOLL
+    struct Registration {
+        //! Distinguishes a new socket that reuses the file descriptor of a closed one.
+        std::weak_ptr<const Sock> sock;
+        Sock::Event requested{0};
+        //! Entry of the `events_per_sock` passed to the current `WaitMany()` call.
+        Sock::Events* events{nullptr};
+    };
+
+    /**
+     * Bring the epoll registrations in line with `events_per_sock`.
+     * @return false if the epoll instance cannot be used for these sockets
+     */
+    bool Update(Sock::EventsPerSock& events_per_sock);
+
+    int m_epoll_fd{-1};
+    std::unordered_map<SOCKET, Registration> m_registered;
+    std::vector<epoll_event> m_ready;
+#endif
+};
+
 /** Return readable error string for a network error code */
 std::string NetworkErrorString(int err);
 
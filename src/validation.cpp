@@ -93,6 +93,9 @@ static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 static constexpr std::chrono::hours DATABASE_FLUSH_INTERVAL{24};
 /** Maximum age of our tip for us to be considered current for fee estimation */
 static constexpr std::chrono::hours MAX_FEE_ESTIMATION_TIP_AGE{3};
+/** Minimum number of inputs of a transaction or package to verify its scripts on the script check
+ *  queue, below which waking up the worker threads costs more than it saves */
+static constexpr size_t MIN_QUEUED_MEMPOOL_SCRIPT_CHECKS{4};
 const std::vector<std::string> CHECKLEVEL_DOC {
     "level 0 reads the blocks from disk",
     "level 1 verifies block validity",
@@ -481,10 +484,14 @@ public:
         /** Whether CPFP carveout and RBF carveout are granted. */
         const bool m_allow_carveouts;
 
+        /** When true, scripts are not verified. Only for transactions that were validated
+         * against the current tip before, see AcceptBatchToMemoryPool(). */
+        const bool m_skip_script_checks;
+
         /** Parameters for single transaction mempool validation. */
         static ATMPArgs SingleAccept(const CChainParams& chainparams, int64_t accept_time,
                                      bool bypass_limits, std::vector<COutPoint>& coins_to_uncache,
-                                     bool test_accept) {
+                                     bool test_accept, bool skip_script_checks) {
             return ATMPArgs{/* m_chainparams */ chainparams,
                             /* m_accept_time */ accept_time,
                             /* m_bypass_limits */ bypass_limits,
@@ -496,6 +503,7 @@ public:
                             /* m_package_feerates */ false,
                             /* m_client_maxfeerate */ {}, // checked by caller
                             /* m_allow_carveouts */ true,
+                            /* m_skip_script_checks */ skip_script_checks,
             };
         }
 
@@ -513,6 +521,7 @@ public:
                             /* m_package_feerates */ false,
                             /* m_client_maxfeerate */ {}, // checked by caller
                             /* m_allow_carveouts */ false,
+                            /* m_skip_script_checks */ false,
             };
         }
 
@@ -530,6 +539,7 @@ public:
                             /* m_package_feerates */ true,
                             /* m_client_maxfeerate */ client_maxfeerate,
                             /* m_allow_carveouts */ false,
+                            /* m_skip_script_checks */ false,
             };
         }
 
@@ -546,6 +556,7 @@ public:
                             /* m_package_feerates */ false, // only 1 transaction
                             /* m_client_maxfeerate */ package_args.m_client_maxfeerate,
                             /* m_allow_carveouts */ false,
+                            /* m_skip_script_checks */ false,
             };
         }
 
@@ -562,7 +573,8 @@ public:
                  bool package_submission,
                  bool package_feerates,
                  std::optional<CFeeRate> client_maxfeerate,
-                 bool allow_carveouts)
+                 bool allow_carveouts,
+                 bool skip_script_checks)
             : m_chainparams{chainparams},
               m_accept_time{accept_time},
               m_bypass_limits{bypass_limits},
@@ -573,7 +585,8 @@ public:
               m_package_submission{package_submission},
               m_package_feerates{package_feerates},
               m_client_maxfeerate{client_maxfeerate},
-              m_allow_carveouts{allow_carveouts}
+              m_allow_carveouts{allow_carveouts},
+              m_skip_script_checks{skip_script_checks}
         {
             // If we are using package feerates, we must be doing package submission.
             // It also means carveouts and sibling eviction are not permitted.
@@ -583,6 +596,7 @@ public:
                 Assume(!m_allow_sibling_eviction);
             }
             if (m_allow_sibling_eviction) Assume(m_allow_replacement);
+            if (m_skip_script_checks) Assume(!m_test_accept);
         }
     };
 
@@ -658,6 +672,8 @@ private:
         /** A temporary cache containing serialized transaction data for signature verification.
          * Reused across PolicyScriptChecks and ConsensusScriptChecks. */
         PrecomputedTransactionData m_precomputed_txdata;
+        /** Whether the script checks using our policy flags already passed on the script check queue. */
+        bool m_policy_scripts_checked{false};
     };
 
     // Run the policy checks on a given transaction, excluding any script checks.
@@ -680,6 +696,11 @@ private:
     // only invoke this on transactions that have otherwise passed policy checks.
     bool PolicyScriptChecks(const ATMPArgs& args, Workspace& ws) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Run the script checks using our policy flags for all transactions at once on the
+    // script check queue, if it has worker threads and there are enough inputs to split.
+    // Failures are left to PolicyScriptChecks(), which finds and reports them.
+    void QueuePolicyScriptChecks(std::span<Workspace> workspaces) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
     // PolicyScriptChecks(). This requires that all inputs either be in our
@@ -1235,7 +1256,7 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
 
     // Check input scripts and signatures.
     // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-    if (!CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false, ws.m_precomputed_txdata, GetValidationCache())) {
+    if (!ws.m_policy_scripts_checked && !CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false, ws.m_precomputed_txdata, GetValidationCache())) {
         // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
         // need to turn both off, and compare against just turning off CLEANSTACK
         // to see if the failure is specifically due to witness validation.
@@ -1252,6 +1273,33 @@ bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs& args, Workspace& ws)
     return true;
 }
 
+void MemPoolAccept::QueuePolicyScriptChecks(std::span<Workspace> workspaces)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    CCheckQueue<CScriptCheck>& queue{m_active_chainstate.m_chainman.GetCheckQueue()};
+    if (!queue.HasThreads()) return;
+    const size_t num_inputs{std::accumulate(workspaces.begin(), workspaces.end(), size_t{0},
+                                            [](size_t sum, const Workspace& ws) { return sum + ws.m_ptx->vin.size(); })};
+    if (num_inputs < MIN_QUEUED_MEMPOOL_SCRIPT_CHECKS) return;
+
+    // Block validation uses the same queue while holding cs_main, so the two
+    // never compete for it.
+    CCheckQueueControl<CScriptCheck> control{&queue};
+    for (Workspace& ws : workspaces) {
+        std::vector<CScriptCheck> checks;
+        TxValidationState state_dummy;
+        if (!CheckInputScripts(*ws.m_ptx, state_dummy, m_view, STANDARD_SCRIPT_VERIFY_FLAGS, true, false,
+                               ws.m_precomputed_txdata, GetValidationCache(), &checks)) {
+            return;
+        }
+        control.Add(std::move(checks));
+    }
+    if (!control.Wait()) return;
+    for (Workspace& ws : workspaces) ws.m_policy_scripts_checked = true;
+}
+
 bool MemPoolAccept::ConsensusScriptChecks(const ATMPArgs& args, Workspace& ws)
 {
     AssertLockHeld(cs_main);
@@ -1461,9 +1509,12 @@ MempoolAcceptResult MemPoolAccept::AcceptSingleTransaction(const CTransactionRef
 
     // Perform the inexpensive checks first and avoid hashing and signature verification unless
     // those checks pass, to mitigate CPU exhaustion denial-of-service attacks.
-    if (!PolicyScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+    if (!args.m_skip_script_checks) {
+        QueuePolicyScriptChecks({&ws, 1});
+        if (!PolicyScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
 
-    if (!ConsensusScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+        if (!ConsensusScriptChecks(args, ws)) return MempoolAcceptResult::Failure(ws.m_state);
+    }
 
     const CFeeRate effective_feerate{ws.m_modified_fees, static_cast<uint32_t>(ws.m_vsize)};
     // Tx was accepted, but not added
@@ -1589,6 +1640,7 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(const std::
         return PackageMempoolAcceptResult(package_state, std::move(results));
     }
 
+    QueuePolicyScriptChecks(workspaces);
     for (Workspace& ws : workspaces) {
         ws.m_package_feerate = package_feerate;
         if (!PolicyScriptChecks(args, ws)) {
@@ -1860,7 +1912,8 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
     CTxMemPool& pool{*active_chainstate.GetMempool()};
 
     std::vector<COutPoint> coins_to_uncache;
-    auto args = MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_time, bypass_limits, coins_to_uncache, test_accept);
+    auto args = MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_time, bypass_limits, coins_to_uncache, test_accept,
+                                                      /*skip_script_checks=*/false);
     MempoolAcceptResult result = MemPoolAccept(pool, active_chainstate).AcceptSingleTransaction(tx, args);
     if (result.m_result_type != MempoolAcceptResult::ResultType::VALID) {
         // Remove coins that were not present in the coins cache before calling
@@ -1881,6 +1934,77 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
     return result;
 }
 
+/**
+ * Verify the scripts of a batch of transactions on the script check queue, which stores the
+ * signatures found valid in the signature cache. Failures are left to mempool acceptance,
+ * which finds and reports them.
+ */
+static void PrecheckBatchScripts(Chainstate& active_chainstate, const CTxMemPool& pool, std::span<const CTransactionRef> txs,
+                                 std::vector<std::vector<COutPoint>>& coins_to_uncache) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    CCheckQueue<CScriptCheck>& queue{active_chainstate.m_chainman.GetCheckQueue()};
+    if (!queue.HasThreads()) return;
+
+    LOCK(pool.cs);
+    CCoinsViewCache& coins_tip{active_chainstate.CoinsTip()};
+    CCoinsViewMemPool mempool_view{&coins_tip, pool};
+    CCoinsViewCache view{&mempool_view};
+    // The checks refer to the precomputed data, so it must stay in place until they ran.
+    std::vector<PrecomputedTransactionData> txdata(txs.size());
+    CCheckQueueControl<CScriptCheck> control{&queue};
+    for (size_t i{0}; i < txs.size(); ++i) {
+        const CTransaction& tx{*txs[i]};
+        const bool have_inputs{std::ranges::all_of(tx.vin, [&](const CTxIn& txin) {
+            if (!coins_tip.HaveCoinInCache(txin.prevout)) coins_to_uncache[i].push_back(txin.prevout);
+            return view.HaveCoin(txin.prevout);
+        })};
+        std::vector<CScriptCheck> checks;
+        TxValidationState state_dummy;
+        if (have_inputs && CheckInputScripts(tx, state_dummy, view, STANDARD_SCRIPT_VERIFY_FLAGS, /*cacheSigStore=*/true, /*cacheFullScriptStore=*/false,
+                                             txdata[i], active_chainstate.m_chainman.m_validation_cache, &checks)) {
+            control.Add(std::move(checks));
+        }
+        // Make the outputs available to the children later in the batch.
+        mempool_view.PackageAddTransaction(txs[i]);
+    }
+    (void)control.Wait();
+}
+
+std::vector<MempoolAcceptResult> AcceptBatchToMemoryPool(Chainstate& active_chainstate, std::span<const CTransactionRef> txs,
+                                                         std::span<const int64_t> accept_times, bool skip_script_checks)
+{
+    AssertLockHeld(::cs_main);
+    assert(txs.size() == accept_times.size());
+    const CChainParams& chainparams{active_chainstate.m_chainman.GetParams()};
+    assert(active_chainstate.GetMempool() != nullptr);
+    CTxMemPool& pool{*active_chainstate.GetMempool()};
+
+    std::vector<std::vector<COutPoint>> coins_to_uncache(txs.size());
+    if (!skip_script_checks) PrecheckBatchScripts(active_chainstate, pool, txs, coins_to_uncache);
+
+    std::vector<MempoolAcceptResult> results;
+    results.reserve(txs.size());
+    for (size_t i{0}; i < txs.size(); ++i) {
+        auto args = MemPoolAccept::ATMPArgs::SingleAccept(chainparams, accept_times[i], /*bypass_limits=*/false, coins_to_uncache[i],
+                                                          /*test_accept=*/false, skip_script_checks);
+        const auto& result{results.emplace_back(MemPoolAccept(pool, active_chainstate).AcceptSingleTransaction(txs[i], args))};
+        if (result.m_result_type != MempoolAcceptResult::ResultType::VALID) {
+            // As in AcceptToMemoryPool(), don't keep the coins of rejected transactions cached.
+            for (const COutPoint& outpoint : coins_to_uncache[i]) {
+                active_chainstate.CoinsTip().Uncache(outpoint);
+            }
+            TRACE2(mempool, rejected,
+                    txs[i]->GetHash().data(),
+                    result.m_state.GetRejectReason().c_str()
+            );
+        }
+    }
+    BlockValidationState state_dummy;
+    active_chainstate.FlushStateToDisk(state_dummy, FlushStateMode::PERIODIC);
+    return results;
+}
+
 PackageMempoolAcceptResult ProcessNewPackage(Chainstate& active_chainstate, CTxMemPool& pool,
                                                    const Package& package, bool test_accept, const std::optional<CFeeRate>& client_maxfeerate)
 {
@@ -3906,15 +4030,21 @@ void ChainstateManager::ReceivedBlockTransactions(const CBlock& block, CBlockInd
     }
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+/** Context-independent header checks, given whether the header hash satisfies its proof of work */
+static bool CheckBlockHeader(bool pow_valid, BlockValidationState& state)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (!pow_valid)
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
 
     return true;
 }
 
+static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+{
+    return CheckBlockHeader(/*pow_valid=*/!fCheckPOW || CheckProofOfWork(block.GetHash(), block.nBits, consensusParams), state);
+}
+
 static bool CheckMerkleRoot(const CBlock& block, BlockValidationState& state)
 {
     if (block.m_checked_merkle_root) return true;
@@ -4275,11 +4405,17 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
 }
 
 bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked)
+{
+    const uint256 hash{block.GetHash()};
+    const bool pow_valid{CheckProofOfWork(hash, block.nBits, GetConsensus())};
+    return AcceptBlockHeader(block, hash, pow_valid, m_best_header, state, ppindex, min_pow_checked);
+}
+
+bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, bool pow_valid, CBlockIndex*& best_header, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked)
 {
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf{m_blockman.m_block_index.find(hash)};
     if (hash != GetConsensus().hashGenesisBlock) {
         if (miSelf != m_blockman.m_block_index.end()) {
@@ -4294,7 +4430,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, GetConsensus())) {
+        if (!CheckBlockHeader(pow_valid, state)) {
             LogDebug(BCLog::VALIDATION, "%s: Consensus::CheckBlockHeader: %s, %s\n", __func__, hash.ToString(), state.ToString());
             return false;
         }
@@ -4359,7 +4495,7 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
         LogDebug(BCLog::VALIDATION, "%s: not adding new block header %s, missing anti-dos proof-of-work validation\n", __func__, hash.ToString());
         return state.Invalid(BlockValidationResult::BLOCK_HEADER_LOW_WORK, "too-little-chainwork");
     }
-    CBlockIndex* pindex{m_blockman.AddToBlockIndex(block, m_best_header)};
+    CBlockIndex* pindex{m_blockman.AddToBlockIndex(block, hash, best_header)};
 
     if (ppindex)
         *ppindex = pindex;
@@ -4388,20 +4524,39 @@ bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValida
 bool ChainstateManager::ProcessNewBlockHeaders(std::span<const CBlockHeader> headers, bool min_pow_checked, BlockValidationState& state, const CBlockIndex** ppindex)
 {
     AssertLockNotHeld(cs_main);
+
+    // Hash all headers and check their proof of work up front, without
+    // holding cs_main, so that the lock only covers the index lookups,
+    // contextual checks and insertions. Failures are still reported in
+    // order, once the preceding headers have been accepted. The best header
+    // is tracked locally and applied once, together with the consistency
+    // check, for the whole batch.
+    std::vector<uint256> hashes;
+    std::vector<bool> pow_valid;
+    hashes.reserve(headers.size());
+    pow_valid.reserve(headers.size());
+    for (const CBlockHeader& header : headers) {
+        hashes.push_back(header.GetHash());
+        pow_valid.push_back(CheckProofOfWork(hashes.back(), header.nBits, GetConsensus()));
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        CBlockIndex* best_header{m_best_header};
+        bool accepted{true};
+        for (size_t i = 0; i < headers.size() && accepted; ++i) {
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            bool accepted{AcceptBlockHeader(header, state, &pindex, min_pow_checked)};
-            CheckBlockIndex();
-
-            if (!accepted) {
-                return false;
-            }
-            if (ppindex) {
+            accepted = AcceptBlockHeader(headers[i], hashes[i], pow_valid[i], best_header, state, &pindex, min_pow_checked);
+            if (accepted && ppindex) {
                 *ppindex = pindex;
             }
         }
+        m_best_header = best_header;
+        CheckBlockIndex();
+
+        if (!accepted) {
+            return false;
+        }
     }
     if (NotifyHeaderTip()) {
         if (IsInitialBlockDownload() && ppindex && *ppindex) {
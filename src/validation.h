@@ -267,6 +267,25 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate& active_chainstate, const CTra
                                        int64_t accept_time, bool bypass_limits, bool test_accept)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Try to add a batch of transactions to the memory pool, one after the other as
+ * AcceptToMemoryPool() would. Transactions may spend outputs of earlier ones in the batch.
+ *
+ * The scripts of the whole batch are first verified together on the script check queue.
+ * Valid signatures are stored in the signature cache, so the checks of the single
+ * transactions find them there instead of verifying them one input at a time.
+ *
+ * @param[in]  txs                 The transactions, parents before their children.
+ * @param[in]  accept_times        The timestamp for adding each transaction to the mempool.
+ * @param[in]  skip_script_checks  When true, don't verify scripts at all. Only for transactions
+ *                                 that were accepted to a mempool on the current tip before.
+ *
+ * @returns a MempoolAcceptResult for each transaction.
+ */
+std::vector<MempoolAcceptResult> AcceptBatchToMemoryPool(Chainstate& active_chainstate, std::span<const CTransactionRef> txs,
+                                                         std::span<const int64_t> accept_times, bool skip_script_checks)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
 * Validate (and maybe submit) a package to the mempool. See doc/policy/packages.md for full details
 * on package validation rules.
@@ -930,6 +949,21 @@ private:
         BlockValidationState& state,
         CBlockIndex** ppindex,
         bool min_pow_checked) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * As above, for a header whose hash and proof of work have already been
+     * computed, which ProcessNewBlockHeaders does for a whole batch of headers
+     * before taking cs_main. A new index entry with more work than best_header
+     * replaces it, so that a batch can update m_best_header only once.
+     */
+    bool AcceptBlockHeader(
+        const CBlockHeader& block,
+        const uint256& hash,
+        bool pow_valid,
+        CBlockIndex*& best_header,
+        BlockValidationState& state,
+        CBlockIndex** ppindex,
+        bool min_pow_checked) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     friend Chainstate;
 
     /** Most recent headers presync progress update, for rate-limiting. */
@@ -5,6 +5,7 @@
 
 import threading
 from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
 from random import randbytes
 
 
@@ -12,11 +13,17 @@ class NetDeadlockTest(BitcoinTestFramework):
     def set_test_params(self):
         self.setup_clean_chain = True
         self.num_nodes = 2
+        self.extra_args = [["-sockethandlerthreads=2"], []]
 
     def run_test(self):
         node0 = self.nodes[0]
         node1 = self.nodes[1]
 
+        self.log.info("Reconnect so that the second socket handler thread of node0 services the connection")
+        self.disconnect_nodes(0, 1)
+        self.connect_nodes(0, 1)
+        assert_equal([peer["id"] % 2 for peer in node0.getpeerinfo()], [1])
+
         self.log.info("Simultaneously send a large message on both sides")
         rand_msg = randbytes(4000000).hex()
 